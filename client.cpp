@@ -7,9 +7,22 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
 #endif
 #include <sstream>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <cctype> 
 #include <signal.h>
 #include <errno.h>
@@ -17,9 +30,12 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <io.h>
 #pragma comment(lib, "Ws2_32.lib")
 #endif
 
+#include "handeval.h"
+
 #ifdef _WIN32
 using socket_t = SOCKET;
 #define READSOCK(s,b,l) recv((SOCKET)(s), (char*)(b), (int)(l), 0)
@@ -33,6 +49,25 @@ using socket_t = int;
 #endif
 
 #define PORT 5555
+#define WIRE_VERSION 1 // Binary protocol version we ask the server for
+#define WIRE_HEADER 3
+#define SESSION_BACKLOG_BYTES (32 * 1024) // Output kept for a table without focus
+#define EQUITY_CHUNK 1000          // Overlay trials per step of the equity worker
+#define EQUITY_MAX_TRIALS 200000   // An estimate stops here,
+#define EQUITY_TARGET_ERROR 0.002  // or once its standard error is this small
+
+// Frame types; layouts are documented in server.cpp (Wire Protocol).
+enum WireFrame : uint8_t {
+    WF_TEXT = 1, WF_ACTION = 2, WF_STATE = 3, WF_HOLE = 4, WF_BOARD = 5, WF_CHAT = 6,
+    WF_YOUR_MOVE = 7, WF_SHOWDOWN = 8, WF_WIN = 9, WF_GAME_STARTING = 10, WF_HAND_OVER = 11,
+    WF_TURN_OVER = 12, WF_GAME = 13,
+};
+enum WireAction : uint8_t { WA_FOLD = 0, WA_CHECK = 1, WA_CALL = 2, WA_RAISE = 3 };
+enum WireSeatFlags : uint8_t { WS_FOLDED = 1, WS_ALL_IN = 2, WS_OFFLINE = 4 };
+
+// The game, from the server's WF_GAME frame (the same numbering as the
+// server's GameVariant). The equity overlay only prices games it was told about.
+enum GameKind { GAME_UNKNOWN = -1, GAME_HOLDEM, GAME_OMAHA, GAME_SHORTDECK };
 
 // --- ANSI Color Codes ---
 #define RESET   "\033[0m"
@@ -45,10 +80,52 @@ using socket_t = int;
 #define CYAN    "\033[36m"     
 #define WHITE   "\033[37m"      
 
-socket_t g_sock = 0;
-std::atomic<bool> g_myTurn{false};
-std::vector<std::string> g_holeCards;
-std::vector<std::string> g_communityCards;
+// Seats as the server's WF_STATE frames describe them.
+struct SeatView {
+    std::string name;
+    int chips = 0;
+    uint8_t flags = 0;
+};
+
+// The equity overlay's question for one table and the worker's answer so
+// far. Both sides touch it only under g_equityMutex.
+struct EquityView {
+    uint64_t generation = 0;      // Bumped per question; the worker drops work for older ones
+    std::vector<uint8_t> hole, board;
+    int opponents = 0;
+    bool shortDeck = false;       // 36-card deck and short-deck ranking
+    bool running = false;         // The worker is still refining
+    double wins = 0;              // Pots won, ties shared
+    long long trials = 0;
+    bool fresh = false;           // Numbers the loop has not drawn yet
+};
+
+// One table connection. The client can hold several; each keeps its own
+// game state, and its output waits in screen until the loop draws it.
+struct Session {
+    int id = 0;                   // Shown to the user, from 1
+    std::string label;            // host:port
+    socket_t sock = INVALID_SOCKET_VAL;
+    int wire = 0;                 // Binary protocol version the server agreed to; 0 = text
+    bool spectating = false;
+    bool myTurn = false;
+    bool alert = false;           // Its turn came up while another table had focus
+    std::vector<uint8_t> holeCards;      // Card codes: suit * 13 + value - 2
+    std::vector<uint8_t> communityCards;
+    std::vector<SeatView> seats;
+    std::string inbox;            // Received bytes not handled yet
+    std::string screen;           // Output not drawn yet
+    // What the equity overlay prices a call with
+    std::string name;             // Our seat, from WELCOME
+    GameKind game = GAME_UNKNOWN;
+    int pot = 0;
+    int streetBet = 0;            // Bet to match on this street, from the actions
+    int myBet = 0;                // What we put in on this street
+    int live = 0;                 // Seats still in the hand, from the last table
+    int tableLive = 0;            // Live rows of the text table being read
+    bool inHand = false;          // Our own seat was ACTIVE or ALL-IN
+    EquityView equity;
+};
 
 static bool sendAll(int sock, const char* data, size_t len) {
     size_t total = 0;
@@ -64,251 +141,1085 @@ static bool sendAll(int sock, const char* data, size_t len) {
     return true;
 }
 
-std::string displayCards(const std::vector<std::string> &cards) {
-    std::stringstream ss;
+// ===== Card Glyphs =====
+// Each card's five rows of art and its short colored text ("A♥") are
+// rendered once, with their color escapes, the first time any card is shown.
+struct CardGlyph {
+    std::string rows[5];
+    std::string text;
+};
+
+const CardGlyph* cardGlyphs() {
+    static const CardGlyph* glyphs = []() {
+        static CardGlyph g[52];
+        static const char* ranks[] = {"2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K", "A"};
+        static const char* suits[] = {"♥", "♦", "♣", "♠"};
+        static const char* colors[] = {RED, RED, CYAN, CYAN};
+        for (int code = 0; code < 52; ++code) {
+            std::string rank = ranks[code % 13];
+            std::string color = colors[code / 13];
+            std::string suit = suits[code / 13];
+            CardGlyph& c = g[code];
+            c.rows[0] = "┌─────┐ ";
+            c.rows[1] = "│" + color + rank + RESET + (rank.size() == 1 ? "    │ " : "   │ ");
+            c.rows[2] = "│  " + color + suit + RESET + "  │ ";
+            c.rows[3] = "│" + std::string(rank.size() == 1 ? "    " : "   ") + color + rank + RESET + "│ ";
+            c.rows[4] = "└─────┘ ";
+            c.text = color + rank + suit + RESET;
+        }
+        return g;
+    }();
+    return glyphs;
+}
+
+// "AH", "10D" -> card code; 0xFF when unreadable.
+uint8_t cardFromText(const std::string& card) {
+    static const std::string suits = "HDCS";
+    if (card.size() < 2) return 0xFF;
+    size_t suit = suits.find(card.back());
+    std::string rank = card.substr(0, card.size() - 1);
+    int value = 0;
+    if (rank == "A") value = 14;
+    else if (rank == "K") value = 13;
+    else if (rank == "Q") value = 12;
+    else if (rank == "J") value = 11;
+    else value = std::atoi(rank.c_str());
+    if (suit == std::string::npos || value < 2 || value > 14) return 0xFF;
+    return (uint8_t)(suit * 13 + value - 2);
+}
+
+void displayCards(Session& s, const std::vector<uint8_t> &cards) {
+    const CardGlyph* glyphs = cardGlyphs();
     for (int line = 0; line < 5; line++) {
-        for (const auto &c_str : cards) {
-            if (c_str.empty()) continue;
-
-            std::string rank = c_str.substr(0, c_str.size() - 1);
-            std::string suit_letter(1, c_str.back());
-            std::string displaySuit = "?";
-            std::string color = WHITE; 
-
-            if (suit_letter == "H") { displaySuit = "♥"; color = RED; }
-            else if (suit_letter == "D") { displaySuit = "♦"; color = RED; }
-            else if (suit_letter == "C") { displaySuit = "♣"; color = CYAN; } 
-            else if (suit_letter == "S") { displaySuit = "♠"; color = CYAN; }
-
-            if (line == 0) ss << "┌─────┐ ";
-            else if (line == 1) ss << "│" << color << rank << RESET << (rank.size() == 1 ? "    │ " : "   │ ");
-            else if (line == 2) ss << "│  " << color << displaySuit << RESET << "  │ ";
-            else if (line == 3) ss << "│" << (rank.size() == 1 ? "    " : "   ") << color << rank << RESET << "│ ";
-            else ss << "└─────┘ ";
+        for (uint8_t c : cards) s.screen += glyphs[c].rows[line];
+        s.screen += '\n';
+    }
+}
+
+// ===== Hand Evaluator =====
+// The server's evaluator from handeval.h, in the table's ranking: short deck
+// ranks flushes above full houses and plays A-6-7-8-9 as a straight.
+long long rankHand(uint64_t hand, bool shortDeck) {
+    RankFields f;
+    if (shortDeck) {
+        rankFields<ShortDeckRanking>(hand, f);
+        return finishRank<ShortDeckRanking>(f);
+    }
+    rankFields<StandardRanking>(hand, f);
+    return finishRank<StandardRanking>(f);
+}
+
+// Best hand from hole cards and a full board: any five of the seven, or with
+// four hole cards (Omaha) exactly two of them and three from the board.
+long long bestHand(const uint8_t* hole, size_t holeCount, const uint8_t* board, bool shortDeck) {
+    uint64_t boardMask = 0;
+    for (int i = 0; i < 5; ++i) boardMask |= cardBit(board[i]);
+    if (holeCount != 4) {
+        uint64_t hand = boardMask;
+        for (size_t i = 0; i < holeCount; ++i) hand |= cardBit(hole[i]);
+        return rankHand(hand, shortDeck);
+    }
+    long long best = 0;
+    for (int i = 0; i < 4; ++i)
+        for (int j = i + 1; j < 4; ++j)
+            for (int a = 0; a < 5; ++a)
+                for (int b = a + 1; b < 5; ++b)
+                    for (int c = b + 1; c < 5; ++c) {
+                        uint64_t hand = cardBit(hole[i]) | cardBit(hole[j]) |
+                                        cardBit(board[a]) | cardBit(board[b]) | cardBit(board[c]);
+                        best = std::max(best, rankHand(hand, shortDeck));
+                    }
+    return best;
+}
+
+// ===== Equity Overlay =====
+// Our chance to win the pot, estimated by dealing the unseen cards at
+// random, next to the pot odds of calling. A worker thread refines each
+// table's estimate EQUITY_CHUNK trials at a time, and the event loop redraws
+// the overlay as the numbers firm up, so input is never waiting on it.
+std::mutex g_equityMutex;
+std::condition_variable g_equityWork;
+bool g_equityStop = false;   // Set at exit; the worker returns
+bool g_tty = false;          // Whether stdout is a terminal: the overlay is redrawn in place there
+bool g_overlayLast = false;  // The last line written is the focused table's overlay
+
+static inline uint64_t mix64(uint64_t z) { // SplitMix64 finalizer, as the server's streams use
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Pots won (ties shared) over `trials` deals of the unseen cards.
+double equityTrials(const EquityView& q, int trials, uint64_t key) {
+    uint8_t deck[52];
+    uint64_t seen = 0;
+    for (uint8_t c : q.hole) seen |= cardBit(c);
+    for (uint8_t c : q.board) seen |= cardBit(c);
+    int left = 0;
+    for (uint8_t c = 0; c < 52; ++c) {
+        if (q.shortDeck && c % 13 + 2 < 6) continue; // Short deck starts at six
+        if (!(seen & cardBit(c))) deck[left++] = c;
+    }
+    size_t holeCount = q.hole.size();
+    int opponents = std::min<int>(q.opponents, (left - 5) / (int)holeCount);
+    int draw = opponents * (int)holeCount + 5 - (int)q.board.size();
+    uint8_t board[5];
+    std::copy(q.board.begin(), q.board.end(), board);
+
+    double wins = 0;
+    uint64_t counter = 0;
+    for (int t = 0; t < trials; ++t) {
+        // Partial shuffle: only the cards this trial deals
+        for (int i = 0; i < draw; ++i) {
+            uint32_t r = (uint32_t)(mix64(key + ++counter * 0x9E3779B97F4A7C15ULL) >> 32);
+            int j = i + (int)(((uint64_t)r * (uint32_t)(left - i)) >> 32);
+            std::swap(deck[i], deck[j]);
         }
-        ss << "\n";
+        const uint8_t* next = deck;
+        for (size_t k = q.board.size(); k < 5; ++k) board[k] = *next++;
+        long long mine = bestHand(q.hole.data(), holeCount, board, q.shortDeck);
+        int ties = 0;
+        bool lost = false;
+        for (int o = 0; o < opponents && !lost; ++o, next += holeCount) {
+            long long theirs = bestHand(next, holeCount, board, q.shortDeck);
+            lost = theirs > mine;
+            ties += theirs == mine;
+        }
+        if (!lost) wins += 1.0 / (ties + 1);
     }
-    return ss.str();
+    return wins;
 }
 
-void receiveMessages() {
-    char buffer[1024];
-    std::string networkBuffer = "";
-
-    while(true) {
-        int valread = READSOCK(g_sock, buffer, 1023);
-        if(valread <= 0) {
-            std::cout << RED << "Disconnected from server." << RESET << std::endl;
-            g_myTurn = false;
-            CLOSESOCK(g_sock);
-            exit(0);
+// Called whenever something the overlay depends on may have changed: our
+// cards, the board, who is still in. Starts a new estimate if the question
+// changed; with show, also draws what is known so far again (under new
+// cards, or at our turn).
+void askEquity(Session& s, bool show) {
+    if (s.spectating) return;
+    int opponents = s.inHand ? s.live - 1 : 0;
+    size_t holeCount = s.game == GAME_OMAHA ? 4 : 2;
+    bool playable = s.game != GAME_UNKNOWN && s.holeCards.size() == holeCount && opponents > 0;
+    std::lock_guard<std::mutex> lock(g_equityMutex);
+    EquityView& e = s.equity;
+    if (!playable) {
+        if (!e.hole.empty()) {
+            EquityView none;
+            none.generation = e.generation + 1;
+            e = std::move(none);
         }
-        buffer[valread] = '\0';
-        networkBuffer += buffer;
-
-        size_t pos;
-        while ((pos = networkBuffer.find('\n')) != std::string::npos) {
-            std::string msg = networkBuffer.substr(0, pos);
-            networkBuffer.erase(0, pos + 1);
-            msg.erase(std::remove(msg.begin(), msg.end(), '\r'), msg.end());
-
-            if (msg.find("GAME_STARTING") != std::string::npos) {
-                g_communityCards.clear();
-                std::cout << "\n" << MAGENTA << "-------------------------------" << RESET << "\n";
-                std::cout << BOLD << MAGENTA << "--- NEW HAND STARTING ---" << RESET << "\n" << std::endl;
-            }
-            else if (msg.find("YOUR_MOVE") != std::string::npos) {
-                std::cout << "\n" << BOLD << CYAN << ">>> YOUR TURN TO ACT <<<" << RESET << std::endl;
-                g_myTurn = true;
-            }
-            else if (msg.find("HOLE ") == 0) {
-                g_holeCards.clear();
-                std::string rest = msg.substr(5);
-                std::stringstream ss_cards(rest);
-                std::string card;
-                while (ss_cards >> card) { g_holeCards.push_back(card); }
-                std::cout << YELLOW << "--- Your Hole Cards ---" << RESET << std::endl;
-                std::cout << displayCards(g_holeCards); 
-            }
-            else if (msg.find("CARDS ") == 0) {
-                g_communityCards.clear();
-                std::string rest = msg.substr(6);
-                std::stringstream ss_cards(rest);
-                std::string card;
-                while (ss_cards >> card) { g_communityCards.push_back(card); }
-
-                std::string stageName = "";
-                if (g_communityCards.size() == 3) stageName = "FLOP";
-                else if (g_communityCards.size() == 4) stageName = "TURN";
-                else if (g_communityCards.size() == 5) stageName = "RIVER";
-
-                if (!stageName.empty()) {
-                     std::cout << "\n" << MAGENTA << "--- " << stageName << " ---" << RESET;
-                }
-
-                std::cout << "\n" << YELLOW << "--- Your Hand ---" << RESET << std::endl;
-                std::cout << displayCards(g_holeCards);
-                std::cout << YELLOW << "--- Community Cards ---" << RESET << std::endl;
-                std::cout << displayCards(g_communityCards) << std::endl;
-            }
-            else if (msg.find("CHAT:") == 0) {
-                std::string chat = msg.substr(5);
-                size_t colonPos = chat.find(':');
-                if (colonPos != std::string::npos) {
-                    std::string name = chat.substr(0, colonPos);
-                    std::string chatMsg = chat.substr(colonPos + 1);
-                    std::cout << "[" << YELLOW << name << RESET << "]: " << chatMsg << std::endl;
-                }
-            }
+        return;
+    }
+    if (e.hole != s.holeCards || e.board != s.communityCards || e.opponents != opponents) {
+        EquityView next;
+        next.generation = e.generation + 1;
+        next.hole = s.holeCards;
+        next.board = s.communityCards;
+        next.opponents = opponents;
+        next.shortDeck = s.game == GAME_SHORTDECK;
+        next.running = true;
+        e = std::move(next);
+        g_equityWork.notify_one();
+    }
+    if (show) e.fresh = e.trials > 0;
+}
+
+// The overlay line, e.g. "Equity: 62.4% vs 2 opponents (16000 trials)  Pot odds: 40 to call into 120, need 25.0%".
+std::string equityLine(const Session& s, const EquityView& e) {
+    char buffer[200];
+    int n = snprintf(buffer, sizeof(buffer), "Equity: %.1f%% vs %d opponent%s (%lld trials%s)",
+                     100.0 * e.wins / e.trials, e.opponents, e.opponents == 1 ? "" : "s",
+                     e.trials, e.running ? ", refining" : "");
+    int toCall = std::max(0, s.streetBet - s.myBet);
+    if (toCall > 0) {
+        snprintf(buffer + n, sizeof(buffer) - n, "  Pot odds: %d to call into %d, need %.1f%%",
+                 toCall, s.pot, 100.0 * toCall / (s.pot + toCall));
+    } else {
+        snprintf(buffer + n, sizeof(buffer) - n, "  Pot: %d, nothing to call", s.pot);
+    }
+    return CYAN + std::string(buffer) + RESET "\n";
+}
+
+// Betting on the current street, as the overlay prices a call. An ALL-IN
+// raise over the text protocol does not say by how much; binary servers
+// send the exact amount still to call with YOUR_MOVE.
+void noteAction(Session& s, const std::string& name, uint8_t kind, int amount) {
+    if (kind == WA_RAISE) {
+        s.streetBet += amount;
+        if (name == s.name) s.myBet = s.streetBet;
+    } else if (kind == WA_CALL && name == s.name) {
+        s.myBet = s.streetBet;
+    }
+}
+
+// Text tables: counts the rows still in the hand and finds our own.
+void noteTableLine(Session& s, const std::string& msg) {
+    if (msg.compare(0, 3, "┌") == 0) s.tableLive = 0;
+    else if (msg.compare(0, 3, "└") == 0) {
+        s.live = s.tableLive;
+        askEquity(s, false);
+    }
+    else if (msg.compare(0, 4, "│ ") == 0 && msg.find("│ Player ") != 0 && msg.size() > 25) {
+        bool in = msg.find("│ ACTIVE ") != std::string::npos || msg.find("│ ALL-IN ") != std::string::npos;
+        s.tableLive += in;
+        std::string name = msg.substr(4, 17); // The name column
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (!s.name.empty() && name == s.name.substr(0, 17)) s.inHand = in;
+    }
+}
+
+// --- Message handlers, shared by the text and binary protocols ---
+void showLine(Session& s, const char* color, const std::string& msg) {
+    s.screen += color;
+    s.screen += msg;
+    s.screen += RESET "\n";
+}
+
+void showGameStarting(Session& s) {
+    s.communityCards.clear();
+    s.pot = s.streetBet = s.myBet = 0;
+    s.live = 0; // Until this hand's first table
+    askEquity(s, false);
+    s.screen += "\n" MAGENTA "-------------------------------" RESET "\n";
+    s.screen += BOLD MAGENTA "--- NEW HAND STARTING ---" RESET "\n\n";
+}
+
+void showYourMove(Session& s) {
+    s.screen += "\n" BOLD CYAN ">>> YOUR TURN TO ACT <<<" RESET "\n";
+    s.myTurn = true;
+}
+
+// The turn clock ran out; moves typed for that turn would be dropped.
+void showTurnOver(Session& s) {
+    s.myTurn = false;
+    s.alert = false;
+    showLine(s, YELLOW, "--- Time's up: your turn is over ---");
+}
+
+void showHole(Session& s, std::vector<uint8_t> cards) {
+    s.holeCards = std::move(cards);
+    s.screen += YELLOW "--- Your Hole Cards ---" RESET "\n";
+    displayCards(s, s.holeCards); 
+    askEquity(s, true);
+}
+
+// The server repeats the board after every table; a new street is when it grows.
+void showBoard(Session& s, std::vector<uint8_t> cards) {
+    if (cards.size() != s.communityCards.size()) s.streetBet = s.myBet = 0;
+    s.communityCards = std::move(cards);
+    static const char* stages[] = {"", "", "", "FLOP", "TURN", "RIVER"};
+    if (s.communityCards.size() >= 3 && s.communityCards.size() <= 5) {
+        s.screen += "\n" MAGENTA "--- ";
+        s.screen += stages[s.communityCards.size()];
+        s.screen += " ---" RESET;
+    }
+
+    if (!s.holeCards.empty()) {
+        s.screen += "\n" YELLOW "--- Your Hand ---" RESET "\n";
+        displayCards(s, s.holeCards);
+    }
+    s.screen += "\n" YELLOW "--- Community Cards ---" RESET "\n";
+    displayCards(s, s.communityCards);
+    s.screen += '\n';
+    askEquity(s, true);
+}
+
+void showChat(Session& s, const std::string& name, const std::string& chatMsg) {
+    s.screen += "[" YELLOW + name + RESET "]: " + chatMsg + "\n";
+}
 
                                  //SHOWDOWN//
-            else if (msg.find("'s hand: ") != std::string::npos) {
-                // Parse the message e.g., "AI_Bot's hand: 7D 8S"
-                size_t nameEndPos = msg.find("'s hand: ");
-                std::string namePart = msg.substr(0, nameEndPos + 10); // "AI_Bot's hand: "
-                std::string cardData = msg.substr(nameEndPos + 10);    // "7D 8S"
-
-                // Print the name part in yellow
-                std::cout << YELLOW << namePart << RESET;
-
-                // Now parse and print the cards with color
-                std::stringstream ss_cards(cardData);
-                std::string card;
-                while (ss_cards >> card) {
-                    if (card.empty()) continue;
-
-                    std::string rank = card.substr(0, card.size() - 1);
-                    std::string suit_letter(1, card.back());
-                    std::string displaySuit = "?";
-                    std::string color = WHITE; // Default color
-
-                    // --- THIS IS THE COLOR LOGIC ---
-                    if (suit_letter == "H") { displaySuit = "♥"; color = RED; }
-                    else if (suit_letter == "D") { displaySuit = "♦"; color = RED; }
-                    else if (suit_letter == "C") { displaySuit = "♣"; color = CYAN; }
-                    else if (suit_letter == "S") { displaySuit = "♠"; color = CYAN; }
-                    // --- END COLOR LOGIC ---
-
-                    std::cout << color << rank << displaySuit << RESET << " ";
-                }
-                std::cout << std::endl; // End the line
-            }
+// e.g. "AI_Bot's hand: " in yellow, then the cards in their suit colors
+void showShownHand(Session& s, const std::string& name, const std::vector<uint8_t>& cards) {
+    const CardGlyph* glyphs = cardGlyphs();
+    s.screen += YELLOW + name + "'s hand: " RESET;
+    for (uint8_t c : cards) {
+        s.screen += glyphs[c].text;
+        s.screen += ' ';
+    }
+    s.screen += '\n';
+}
 
-             else if (msg.find("Pot: ") != std::string::npos) {
-                 // Color Pot line green
-                 std::cout << GREEN << msg << RESET << std::endl;
-             }
-             else if (msg.find(" folds.") != std::string::npos) {
-                 // Color fold action red
-                 std::cout << RED << msg << RESET << std::endl;
-             }
-             else if (msg.find(" checks.") != std::string::npos || msg.find(" calls ") != std::string::npos) {
-                 // Color check/call action yellow
-                 std::cout << YELLOW << msg << RESET << std::endl;
-             }
-              else if (msg.find(" raises ") != std::string::npos) {
-                 // Color raise action green
-                 std::cout << GREEN << msg << RESET << std::endl;
-             }
-             else if (msg.find(" wins ") != std::string::npos || msg.find("Split pot!") != std::string::npos) {
-                  // Color winner announcement green and bold
-                 std::cout << BOLD << GREEN << msg << RESET << std::endl;
-             }
-             else if (msg.find("--- SHOWDOWN ---") != std::string::npos || msg.find("--- Hand Over ---") != std::string::npos) {
-                  // Color delimiters magenta
-                 std::cout << MAGENTA << msg << RESET << std::endl;
-             }
-            else {
-                std::cout << msg << std::endl;
-            }
-        }
+static std::vector<uint8_t> splitCards(const std::string& text) {
+    std::vector<uint8_t> cards;
+    std::stringstream ss_cards(text);
+    std::string card;
+    while (ss_cards >> card) {
+        uint8_t code = cardFromText(card);
+        if (code < 52) cards.push_back(code);
+    }
+    return cards;
+}
+
+// --- Text protocol ---
+// Messages with a type word ("HOLE", "CARDS", "CHAT:", ...) are dispatched
+// through a table keyed by that word. What is left are sentences about the
+// game ("Bob raises 40."), which only text servers send: binary servers use
+// typed frames for them.
+using LineHandler = void (*)(Session& s, const std::string& msg);
+
+// Colors a game sentence by what it reports.
+void showSentence(Session& s, const std::string& msg) {
+    if (msg.find("'s hand: ") != std::string::npos) {
+        // Parse the message e.g., "AI_Bot's hand: 7D 8S"
+        size_t nameEndPos = msg.find("'s hand: ");
+        showShownHand(s, msg.substr(0, nameEndPos), splitCards(msg.substr(nameEndPos + 9)));
+    }
+    else if (msg.find("Pot: ") != std::string::npos) {
+        if (msg.find("Pot: ") == 0) s.pot = std::atoi(msg.c_str() + 5);
+        showLine(s, GREEN, msg);
+    }
+    else if (msg.find(" folds.") != std::string::npos) showLine(s, RED, msg);
+    else if (msg.find(" checks.") != std::string::npos || msg.find(" calls ") != std::string::npos) {
+        size_t at = msg.find(" calls ");
+        if (at != std::string::npos) noteAction(s, msg.substr(0, at), WA_CALL, 0);
+        showLine(s, YELLOW, msg);
     }
+    else if (msg.find(" raises ") != std::string::npos) {
+        size_t at = msg.find(" raises ");
+        if (msg.find("ALL-IN", at) == std::string::npos) noteAction(s, msg.substr(0, at), WA_RAISE, std::atoi(msg.c_str() + at + 8));
+        showLine(s, GREEN, msg);
+    }
+    else if (msg.find(" wins ") != std::string::npos || msg.find("Split pot!") != std::string::npos) showLine(s, BOLD GREEN, msg);
+    else if (msg.find("--- SHOWDOWN ---") != std::string::npos || msg.find("--- Hand Over ---") != std::string::npos) showLine(s, MAGENTA, msg);
+    else {
+        noteTableLine(s, msg);
+        s.screen += msg;
+        s.screen += '\n';
+    }
+}
+
+const std::unordered_map<std::string, LineHandler>& lineHandlers() {
+    static const std::unordered_map<std::string, LineHandler> handlers = {
+        {"GAME_STARTING", [](Session& s, const std::string&) { showGameStarting(s); }},
+        {"YOUR_MOVE", [](Session& s, const std::string&) { showYourMove(s); askEquity(s, true); }},
+        {"TURN_OVER", [](Session& s, const std::string&) { showTurnOver(s); }},
+        {"WELCOME", [](Session& s, const std::string& msg) {
+            s.name = msg.substr(8);
+            showSentence(s, msg);
+        }},
+        {"WATCHING", [](Session& s, const std::string&) {
+            showLine(s, BOLD MAGENTA, "--- Watching the table; hole cards stay hidden until showdown ---");
+        }},
+        {"RESYNC", [](Session& s, const std::string&) {
+            // We fell behind; the server skipped ahead and sends the current table next.
+            showLine(s, MAGENTA, "--- Catching up: current table ---");
+        }},
+        {"HOLE", [](Session& s, const std::string& msg) { showHole(s, splitCards(msg.substr(4))); }},
+        {"CARDS", [](Session& s, const std::string& msg) { showBoard(s, splitCards(msg.substr(5))); }},
+        {"CHAT:", [](Session& s, const std::string& msg) {
+            size_t colonPos = msg.find(':', 5);
+            if (colonPos != std::string::npos) showChat(s, msg.substr(5, colonPos - 5), msg.substr(colonPos + 1));
+        }},
+    };
+    return handlers;
+}
+
+// One line of the text protocol. The type word ends at a space, or just
+// after the colon of "CHAT:".
+void handleLine(Session& s, const std::string& msg) {
+    size_t end = msg.find_first_of(" :");
+    std::string word = msg.substr(0, end == std::string::npos || msg[end] == ' ' ? end : end + 1);
+    const auto& handlers = lineHandlers();
+    auto it = handlers.find(word);
+    if (it != handlers.end()) it->second(s, msg);
+    else showSentence(s, msg);
 }
 
             // ===== END SHOWDOWN =====//
 
-// ===== Main Function =====
-int main() {
-#ifndef _WIN32
-    signal(SIGPIPE, SIG_IGN);
-#else
-    WSADATA wsaData;
-    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
-        std::cout << "WSAStartup failed.\n"; return -1;
+// --- Binary frames ---
+// Reads the fixed layouts from server.cpp's Wire Protocol section. A
+// truncated frame reads as zeros and empty names rather than past the end.
+struct FrameReader {
+    const char* p;
+    size_t size;
+    size_t at = 0;
+
+    uint8_t u8() { return at < size ? (uint8_t)p[at++] : 0; }
+
+    uint32_t u32() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v = v << 8 | u8();
+        return v;
+    }
+
+    std::string name() {
+        size_t n = std::min<size_t>(u8(), size - at);
+        std::string s(p + at, n);
+        at += n;
+        return s;
     }
-#endif
-    std::string serverIP, playerName;
-    std::cout << "Enter server IP (e.g., 127.0.0.1): ";
-    std::getline(std::cin, serverIP);
-    std::cout << "Enter your player name: ";
-    std::getline(std::cin, playerName);
 
+    std::string rest() {
+        std::string s(p + at, size - at);
+        at = size;
+        return s;
+    }
+
+    std::vector<uint8_t> cards() {
+        std::vector<uint8_t> out;
+        while (at < size) {
+            uint8_t code = u8();
+            if (code < 52) out.push_back(code);
+        }
+        return out;
+    }
+};
+
+// The table as the text protocol draws it, from the seats WF_STATE keeps current.
+void showState(Session& s, int pot) {
+    s.screen += "\n";
+    s.screen += "┌───────────────────┬──────────────┬──────────┐\n";
+    s.screen += "│ Player            │ Chips        │ Status   │\n";
+    s.screen += "├───────────────────┼──────────────┼──────────┤\n";
+    for (const auto& seat : s.seats) {
+        char buffer[100];
+        const char* status = "ACTIVE";
+        if (seat.flags & WS_OFFLINE) status = "OFFLINE";
+        else if (seat.flags & WS_FOLDED) status = "FOLDED";
+        else if (seat.flags & WS_ALL_IN) status = "ALL-IN";
+        snprintf(buffer, 100, "│ %-17.17s │ %-12d │ %-8s │\n", seat.name.c_str(), seat.chips, status);
+        s.screen += buffer;
+    }
+    s.screen += "└───────────────────┴──────────────┴──────────┘\n";
+    showLine(s, GREEN, "Pot: " + std::to_string(pot));
+}
+
+using FrameHandler = void (*)(Session& s, FrameReader& r);
+
+void onTextFrame(Session& s, FrameReader& r) {
+    size_t start = 0;
+    while (start <= r.size) {
+        const char* nl = (const char*)std::memchr(r.p + start, '\n', r.size - start);
+        size_t end = nl ? (size_t)(nl - r.p) : r.size;
+        handleLine(s, std::string(r.p + start, end - start));
+        start = end + 1;
+    }
+}
+
+void onActionFrame(Session& s, FrameReader& r) {
+    uint8_t kind = r.u8();
+    bool allIn = r.u8() != 0;
+    uint32_t value = r.u32();
+    std::string amount = std::to_string(value);
+    std::string name = r.name();
+    noteAction(s, name, kind, (int)value);
+    if (kind == WA_FOLD) showLine(s, RED, name + " folds.");
+    else if (kind == WA_CHECK) showLine(s, YELLOW, name + " checks.");
+    else if (kind == WA_CALL) showLine(s, YELLOW, name + (allIn ? " calls ALL-IN!" : " calls " + amount + "."));
+    else showLine(s, GREEN, name + (allIn ? " raises ALL-IN!" : " raises " + amount + "."));
+}
+
+void onStateFrame(Session& s, FrameReader& r) {
+    int pot = (int)r.u32();
+    s.seats.resize(r.u8());
+    while (r.at < r.size) {
+        uint8_t seat = r.u8();
+        SeatView v;
+        v.flags = r.u8();
+        v.chips = (int)r.u32();
+        v.name = r.name();
+        if (seat < s.seats.size()) s.seats[seat] = v;
+    }
+    s.pot = pot;
+    s.live = 0;
+    for (const auto& seat : s.seats) {
+        bool in = !(seat.flags & (WS_FOLDED | WS_OFFLINE));
+        s.live += in;
+        if (seat.name == s.name) s.inHand = in;
+    }
+    showState(s, pot);
+    askEquity(s, false);
+}
+
+void onYourMoveFrame(Session& s, FrameReader& r) {
+    uint32_t toCall = r.u32();
+    uint32_t pot = r.u32();
+    showYourMove(s);
+    s.screen += "To call: " + std::to_string(toCall) + "  Pot: " + std::to_string(pot) +
+                "  Your chips: " + std::to_string(r.u32()) + "\n";
+    s.pot = (int)pot;
+    s.streetBet = s.myBet + (int)toCall;
+    askEquity(s, true);
+}
+
+void onWinFrame(Session& s, FrameReader& r) {
+    std::string amount = std::to_string(r.u32());
+    std::vector<std::string> winners(r.u8());
+    for (auto& w : winners) w = r.name();
+    std::string hand = r.rest();
+    std::string msg;
+    if (winners.size() == 1 && hand.empty()) msg = winners[0] + " wins " + amount + " (last standing)!";
+    else if (winners.size() == 1) msg = winners[0] + " wins " + amount + " with " + hand + "!";
+    else {
+        msg = "Split pot! " + amount + " split between: ";
+        for (size_t i = 0; i < winners.size(); ++i) msg += (i ? ", " : "") + winners[i];
+        msg += " with " + hand;
+    }
+    showLine(s, BOLD GREEN, msg);
+}
+
+// Indexed by frame type; types this client does not know (a newer
+// server's) have no entry and are skipped.
+const FrameHandler* frameHandlers() {
+    static const FrameHandler* table = []() {
+        static FrameHandler handlers[256] = {};
+        handlers[WF_TEXT] = onTextFrame;
+        handlers[WF_ACTION] = onActionFrame;
+        handlers[WF_STATE] = onStateFrame;
+        handlers[WF_HOLE] = [](Session& s, FrameReader& r) { showHole(s, r.cards()); };
+        handlers[WF_BOARD] = [](Session& s, FrameReader& r) { showBoard(s, r.cards()); };
+        handlers[WF_CHAT] = [](Session& s, FrameReader& r) { std::string name = r.name(); showChat(s, name, r.rest()); };
+        handlers[WF_YOUR_MOVE] = onYourMoveFrame;
+        handlers[WF_SHOWDOWN] = [](Session& s, FrameReader& r) { std::string name = r.name(); showShownHand(s, name, r.cards()); };
+        handlers[WF_WIN] = onWinFrame;
+        handlers[WF_GAME_STARTING] = [](Session& s, FrameReader&) { showGameStarting(s); };
+        handlers[WF_TURN_OVER] = [](Session& s, FrameReader&) { showTurnOver(s); };
+        handlers[WF_HAND_OVER] = [](Session& s, FrameReader&) { s.screen += "HAND_OVER\n"; };
+        handlers[WF_GAME] = [](Session& s, FrameReader& r) {
+            uint8_t game = r.u8();
+            if (game <= GAME_SHORTDECK) s.game = (GameKind)game;
+        };
+        return handlers;
+    }();
+    return table;
+}
+
+// ===== Sessions =====
+std::vector<Session> g_sessions;
+size_t g_focus = 0;         // Table that gets typed input and is drawn
+bool g_focusChanged = false;
+std::string g_out;          // The client's own replies, drawn with the focused table
+
+// Reads the server's answer to PROTO before any input is sent, so nothing
+// typed can go out in the wrong protocol. A server that does not know PROTO
+// answers with its usual first line; that stays in the inbox.
+void negotiate(Session& s) {
+    char buffer[1024];
+    size_t pos;
+    while ((pos = s.inbox.find('\n')) == std::string::npos) {
+        int valread = READSOCK(s.sock, buffer, sizeof(buffer));
+        if (valread <= 0) return;
+        s.inbox.append(buffer, valread);
+    }
+    if (s.inbox.find("PROTO ") == 0) {
+        s.wire = std::atoi(s.inbox.c_str() + 6);
+        s.inbox.erase(0, pos + 1);
+    }
+}
+
+bool openSession(Session& s, const std::string& host, int port, const std::string& playerName) {
     struct sockaddr_in serv_addr;
-    g_sock = socket(AF_INET, SOCK_STREAM, 0);
+    s.sock = socket(AF_INET, SOCK_STREAM, 0);
     int one = 1;
 #ifdef _WIN32
-    setsockopt(g_sock, SOL_SOCKET, SO_KEEPALIVE, (const char*)&one, sizeof(one));
+    setsockopt(s.sock, SOL_SOCKET, SO_KEEPALIVE, (const char*)&one, sizeof(one));
 #else
-    setsockopt(g_sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(s.sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
 #endif
 #ifdef SO_NOSIGPIPE
-    setsockopt(g_sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    setsockopt(s.sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
 #endif
     serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
+    serv_addr.sin_port = htons(port);
 
-    if (inet_pton(AF_INET, serverIP.c_str(), &serv_addr.sin_addr) <= 0) {
-        std::cout << "Invalid address.\n"; return -1;
+    if (inet_pton(AF_INET, host.c_str(), &serv_addr.sin_addr) <= 0) {
+        std::cout << "Invalid address " << host << ".\n"; return false;
+    }
+    if (connect(s.sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        std::cout << "Connection to " << s.label << " failed.\n"; return false;
+    }
+
+    // Players ask for binary frames; spectators are fed text.
+    std::string reg = s.spectating ? "WATCH\n" : "PROTO " + std::to_string(WIRE_VERSION) + " " + playerName + "\n";
+    if (!sendAll(s.sock, reg.c_str(), reg.size())) {
+        std::cout << "Failed to send name to " << s.label << ".\n"; return false;
     }
-    if (connect(g_sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        std::cout << "Connection failed.\n"; return -1;
+    if (!s.spectating) negotiate(s);
+    return true;
+}
+
+// Handles every complete message in the inbox.
+void drainInbox(Session& s) {
+    const FrameHandler* handlers = frameHandlers();
+    size_t at = 0;
+    while (true) {
+        if (s.wire) {
+            if (s.inbox.size() - at < WIRE_HEADER) break;
+            const char* f = s.inbox.data() + at;
+            size_t len = (size_t)(uint8_t)f[1] << 8 | (uint8_t)f[2];
+            if (s.inbox.size() - at < WIRE_HEADER + len) break;
+            FrameReader r{f + WIRE_HEADER, len};
+            if (FrameHandler h = handlers[(uint8_t)f[0]]) h(s, r);
+            at += WIRE_HEADER + len;
+            continue;
+        }
+        size_t pos = s.inbox.find('\n', at);
+        if (pos == std::string::npos) break;
+        std::string msg = s.inbox.substr(at, pos - at);
+        at = pos + 1;
+        if (!msg.empty() && msg.back() == '\r') msg.pop_back();
+        handleLine(s, msg);
     }
+    s.inbox.erase(0, at);
+}
+
+// Reads what the server sent; false once it hung up.
+bool readSession(Session& s) {
+    static char buffer[64 * 1024];
+    int valread = READSOCK(s.sock, buffer, sizeof(buffer));
+    if (valread <= 0) return false;
+    s.inbox.append(buffer, valread);
+    drainInbox(s);
+    return true;
+}
+
+void closeSession(Session& s) {
+    showLine(s, RED, "Disconnected from server.");
+    s.myTurn = false;
+    CLOSESOCK(s.sock); // Also drops it from the epoll set
+    s.sock = INVALID_SOCKET_VAL;
+}
 
+bool anyOpen() {
+    for (const auto& s : g_sessions) {
+        if (s.sock != INVALID_SOCKET_VAL) return true;
+    }
+    return false;
+}
+
+// ===== Equity Worker =====
+// One thread refines every table's estimate, a chunk at a time and taking
+// the tables in turn. It wakes the event loop when there is something new to
+// draw: after 1, 2, 4, 8... chunks and when the estimate is done.
+#ifndef _WIN32
+int g_wakePipe[2] = {-1, -1};
+#endif
+
+void wakeLoop() {
+#ifndef _WIN32
+    char c = 1;
+    ssize_t ignored = write(g_wakePipe[1], &c, 1); // Non-blocking; full means a wakeup is pending anyway
+    (void)ignored;
+#endif
+}
+
+#ifndef _WIN32
+void drainWakes() {
+    char buffer[64];
+    while (read(g_wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+}
+#endif
+
+void equityWorker() {
+    std::unique_lock<std::mutex> lock(g_equityMutex);
+    size_t next = 0;
+    while (true) {
+        Session* s = nullptr;
+        for (size_t i = 0; i < g_sessions.size() && !s; ++i) {
+            Session& candidate = g_sessions[(next + i) % g_sessions.size()];
+            if (candidate.equity.running) {
+                s = &candidate;
+                next = (next + i + 1) % g_sessions.size();
+            }
+        }
+        if (g_equityStop) return;
+        if (!s) {
+            g_equityWork.wait(lock);
+            continue;
+        }
+        EquityView question = s->equity;
+        lock.unlock();
+        double wins = equityTrials(question, EQUITY_CHUNK, mix64(question.generation) ^ question.trials);
+        lock.lock();
+        if (g_equityStop) return;
+
+        EquityView& e = s->equity;
+        if (e.generation != question.generation) continue; // The hand moved on meanwhile
+        e.wins += wins;
+        e.trials += EQUITY_CHUNK;
+        double p = e.wins / e.trials;
+        long long chunks = e.trials / EQUITY_CHUNK;
+        if (e.trials >= EQUITY_MAX_TRIALS ||
+            (chunks >= 10 && std::sqrt(p * (1 - p) / e.trials) < EQUITY_TARGET_ERROR)) {
+            e.running = false;
+        }
+        if (!e.running || (chunks & (chunks - 1)) == 0) {
+            e.fresh = true;
+            wakeLoop();
+        }
+    }
+}
+
+// Batched redraw: runs once per pass of the event loop, after every ready
+// table and input line was handled. The focused table's new output and a
+// one-line notice per other table that needs attention go out in one
+// write; the other tables keep their output (the last
+// SESSION_BACKLOG_BYTES) for when they get focus.
+void redraw() {
+    std::string out;
+    Session& f = g_sessions[g_focus];
+    if (g_focusChanged) {
+        out += "\n" BOLD "=== Table " + std::to_string(f.id) + " (" + f.label + ") ===" RESET "\n";
+        g_focusChanged = false;
+    }
+    out += f.screen;
+    f.screen.clear();
+    // The overlay: refined in place on a terminal, only the final numbers otherwise
+    std::string overlay;
     {
-        std::string reg = playerName + "\n";
-        if (!sendAll(g_sock, reg.c_str(), reg.size())) {
-            std::cout << "Failed to send name to server.\n"; return -1;
+        std::lock_guard<std::mutex> lock(g_equityMutex);
+        EquityView& e = f.equity;
+        if (e.fresh && e.trials > 0 && (g_tty || !e.running)) {
+            overlay = equityLine(f, e);
+            e.fresh = false;
         }
     }
+    if (!overlay.empty() && out.empty() && g_overlayLast) out = "\033[A\033[2K";
+    out += overlay;
+    size_t overlayEnd = out.size();
+    out += g_out;
+    g_out.clear();
+    for (auto& s : g_sessions) {
+        if (&s == &f) continue;
+        if (s.screen.size() > SESSION_BACKLOG_BYTES) {
+            size_t cut = s.screen.find('\n', s.screen.size() - SESSION_BACKLOG_BYTES);
+            s.screen.erase(0, cut == std::string::npos ? s.screen.size() : cut + 1);
+        }
+        bool closed = s.sock == INVALID_SOCKET_VAL;
+        if ((s.myTurn || closed) && !s.alert) {
+            std::string id = std::to_string(s.id);
+            out += YELLOW "[Table " + id + "] ";
+            out += closed ? "Disconnected." : "Your turn. Type '/t " + id + "' to switch.";
+            out += RESET "\n";
+            s.alert = true;
+        }
+    }
+    if (out.empty()) return;
+    g_overlayLast = g_tty && !overlay.empty() && out.size() == overlayEnd;
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+}
 
-    std::thread recvThread(receiveMessages);
-    recvThread.detach();
+// --- Frames to the server ---
+std::string frame(uint8_t type, const std::string& payload) {
+    size_t n = std::min<size_t>(payload.size(), 500); // The server takes frames up to 512 bytes
+    std::string f;
+    f += (char)type;
+    f += (char)(n >> 8);
+    f += (char)n;
+    f.append(payload, 0, n);
+    return f;
+}
 
-    std::cout << "Connected! Waiting for game to start..." << std::endl;
-    std::cout << "Type '/chat <msg>' to chat." << std::endl;
-    std::cout << "Type 'FOLD', 'CALL', 'CHECK', or 'RAISE <amount>' when it's your turn." << std::endl;
+// A checked command ("FOLD", "RAISE 40", ...) as WF_ACTION: kind, amount.
+std::string actionFrame(const std::string& upperInput) {
+    uint8_t kind = WA_FOLD;
+    uint32_t amount = 0;
+    if (upperInput.find("CHECK") == 0) kind = WA_CHECK;
+    else if (upperInput.find("CALL") == 0) kind = WA_CALL;
+    else if (upperInput.find("RAISE") == 0) {
+        kind = WA_RAISE;
+        amount = 50; // As the text protocol does for a raise without an amount
+        try {
+            amount = (uint32_t)std::max(0, std::stoi(upperInput.substr(5)));
+        } catch (...) {}
+    }
+    std::string payload;
+    payload += (char)kind;
+    for (int shift = 24; shift >= 0; shift -= 8) payload += (char)(amount >> shift);
+    return frame(WF_ACTION, payload);
+}
+
+// ===== Keyboard Input =====
+// Keyboard input not yet ended by a newline. The prompts and the event loop
+// both read stdin through it (on POSIX, raw reads of fd 0), so lines piped in
+// ahead of the prompts' answers are kept rather than left in std::cin.
+std::string g_typed;
+
+// One line for a prompt; empty at end of input.
+std::string readLine() {
+    std::cout.flush();
+    std::string line;
+#ifdef _WIN32
+    std::getline(std::cin, line); // The loop's input thread reads std::cin as well
+#else
+    size_t pos;
+    while ((pos = g_typed.find('\n')) == std::string::npos) {
+        char buffer[4096];
+        int valread = (int)read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (valread <= 0) {
+            line.swap(g_typed);
+            return line;
+        }
+        g_typed.append(buffer, valread);
+    }
+    line = g_typed.substr(0, pos);
+    g_typed.erase(0, pos + 1);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+#endif
+    return line;
+}
+
+// "/t N" moves focus to table N and "/tables" lists them; everything else
+// goes to the focused table.
+void handleInput(const std::string& input) {
+    if(input.empty()) return;
+
+    if (input == "/tables") {
+        for (const auto& s : g_sessions) {
+            g_out += (&s == &g_sessions[g_focus] ? "* " : "  ") + std::to_string(s.id) + ": " + s.label;
+            if (s.sock == INVALID_SOCKET_VAL) g_out += " (closed)";
+            else if (s.myTurn) g_out += " (your turn)";
+            g_out += "\n";
+        }
+        return;
+    }
+    if (input.find("/t ") == 0) {
+        int n = std::atoi(input.c_str() + 3);
+        if (n < 1 || n > (int)g_sessions.size()) {
+            g_out += "No table " + input.substr(3) + ". Type '/tables' to list them.\n";
+        } else if ((size_t)n - 1 != g_focus) {
+            g_focus = n - 1;
+            g_focusChanged = true;
+            askEquity(g_sessions[g_focus], true);
+        }
+        return;
+    }
 
-    std::string input;
-    while(std::getline(std::cin, input)) {
-        if(input.empty()) continue;
+    Session& s = g_sessions[g_focus];
+    if (s.sock == INVALID_SOCKET_VAL) {
+        g_out += "This table is closed.\n";
+        return;
+    }
+    if (s.spectating) {
+        g_out += "Spectators can't act or chat.\n";
+        return;
+    }
+
+    if (input.find("/chat ") == 0) {
+        std::string chatMsg = s.wire ? frame(WF_CHAT, input.substr(6)) : "CHAT:" + input.substr(6) + "\n";
+        if (!sendAll(s.sock, chatMsg.c_str(), chatMsg.size())) closeSession(s);
+    }
+    else if (s.myTurn) {
+        std::string upperInput = input;
+        std::transform(upperInput.begin(), upperInput.end(), upperInput.begin(), ::toupper);
 
-        if (input.find("/chat ") == 0) {
-            std::string chatMsg = "CHAT:" + input.substr(6) + "\n";
-            if (!sendAll(g_sock, chatMsg.c_str(), chatMsg.size())) {
-                std::cout << RED << "Disconnected from server." << RESET << std::endl; break;
+        if (upperInput.find("FOLD") != 0 && upperInput.find("CALL") != 0 &&
+            upperInput.find("RAISE") != 0 && upperInput.find("CHECK") != 0) {
+            g_out += "Invalid command. Use FOLD, CALL, CHECK, or RAISE <amount>.\n";
+        } else {
+            std::string line = s.wire ? actionFrame(upperInput) : input + "\n";
+            if (!sendAll(s.sock, line.c_str(), line.size())) {
+                closeSession(s);
+                return;
             }
+            s.myTurn = false;
+            s.alert = false;
+        }
+    }
+    else {
+        g_out += "It's not your turn to make a move.\n";
+    }
+}
+
+// ===== Event Loop =====
+// One thread serves every table and the keyboard: epoll on Linux, poll()
+// on other POSIX systems. Windows cannot poll a console, so a thread there
+// reads lines and the loop polls the sockets with a short timeout.
+#ifdef _WIN32
+std::mutex g_inputMutex;
+std::deque<std::string> g_inputLines;
+std::atomic<bool> g_inputClosed{false};
+#endif
+
+// Handles every complete line in g_typed.
+void handleTyped() {
+    size_t pos;
+    while ((pos = g_typed.find('\n')) != std::string::npos) {
+        std::string line = g_typed.substr(0, pos);
+        g_typed.erase(0, pos + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        handleInput(line);
+    }
+}
+
+void runEventLoop() {
+    bool inputOpen = true;
+#ifdef __linux__
+    const uint32_t stdinKey = UINT32_MAX;
+    const uint32_t wakeKey = UINT32_MAX - 1;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = stdinKey;
+    // Fails when stdin is a regular file, which never blocks: read it every pass.
+    bool stdinPolled = epoll_ctl(ep, EPOLL_CTL_ADD, STDIN_FILENO, &ev) == 0;
+    ev.data.u32 = wakeKey;
+    if (g_wakePipe[0] >= 0) epoll_ctl(ep, EPOLL_CTL_ADD, g_wakePipe[0], &ev);
+    for (size_t i = 0; i < g_sessions.size(); ++i) {
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, g_sessions[i].sock, &ev);
+    }
+#elif defined(_WIN32)
+    std::thread([]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::lock_guard<std::mutex> lock(g_inputMutex);
+            g_inputLines.push_back(line + "\n");
         }
-        else if (g_myTurn) {
-            std::string upperInput = input;
-            std::transform(upperInput.begin(), upperInput.end(), upperInput.begin(), ::toupper);
-
-            if (upperInput.find("FOLD") != 0 && upperInput.find("CALL") != 0 &&
-                upperInput.find("RAISE") != 0 && upperInput.find("CHECK") != 0) {
-                std::cout << "Invalid command. Use FOLD, CALL, CHECK, or RAISE <amount>." << std::endl;
-            } else {
-                std::string line = input + "\n";
-                if (!sendAll(g_sock, line.c_str(), line.size())) {
-                    std::cout << RED << "Disconnected from server." << RESET << std::endl; break;
-                }
-                g_myTurn = false;
+        g_inputClosed = true;
+    }).detach();
+#endif
+
+    handleTyped(); // Lines that came in with the prompts' answers
+    while (inputOpen && anyOpen()) {
+        redraw();
+        std::string input;
+#ifdef __linux__
+        epoll_event events[64];
+        int n = epoll_wait(ep, events, 64, stdinPolled ? -1 : 0);
+        bool stdinReady = !stdinPolled;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u32 == stdinKey) {
+                stdinReady = true;
+                continue;
+            }
+            if (events[i].data.u32 == wakeKey) {
+                drainWakes();
+                continue;
+            }
+            Session& s = g_sessions[events[i].data.u32];
+            if (s.sock != INVALID_SOCKET_VAL && !readSession(s)) closeSession(s);
+        }
+#elif !defined(_WIN32)
+        std::vector<pollfd> fds;
+        fds.push_back({STDIN_FILENO, POLLIN, 0});
+        for (auto& s : g_sessions) {
+            if (s.sock != INVALID_SOCKET_VAL) fds.push_back({s.sock, POLLIN, 0});
+        }
+        if (g_wakePipe[0] >= 0) fds.push_back({g_wakePipe[0], POLLIN, 0});
+        poll(fds.data(), fds.size(), -1);
+        bool stdinReady = fds[0].revents != 0;
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            if (fds[i].fd == g_wakePipe[0]) {
+                drainWakes();
+                continue;
+            }
+            for (auto& s : g_sessions) {
+                if (s.sock == fds[i].fd && !readSession(s)) closeSession(s);
             }
         }
-        else {
-            std::cout << "It's not your turn to make a move." << std::endl;
+#else
+        std::vector<WSAPOLLFD> fds;
+        for (auto& s : g_sessions) {
+            if (s.sock != INVALID_SOCKET_VAL) fds.push_back({s.sock, POLLRDNORM, 0});
         }
+        WSAPoll(fds.data(), (ULONG)fds.size(), 50);
+        for (auto& fd : fds) {
+            if (!fd.revents) continue;
+            for (auto& s : g_sessions) {
+                if (s.sock == fd.fd && !readSession(s)) closeSession(s);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_inputMutex);
+            for (auto& line : g_inputLines) input += line;
+            g_inputLines.clear();
+        }
+        bool stdinReady = !input.empty() || g_inputClosed;
+#endif
+        if (!stdinReady) continue;
+#ifndef _WIN32
+        char buffer[4096];
+        int valread = (int)read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (valread <= 0) inputOpen = false;
+        else input.assign(buffer, valread);
+#else
+        if (input.empty()) inputOpen = false;
+#endif
+        if (!input.empty()) g_overlayLast = false; // The terminal echoed it below the overlay
+        g_typed += input;
+        handleTyped();
+    }
+    redraw();
+}
+
+// ===== Main Function =====
+int main() {
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#else
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
+        std::cout << "WSAStartup failed.\n"; return -1;
+    }
+#endif
+    std::string serverIPs, playerName;
+    std::cout << "Enter server IP (e.g., 127.0.0.1; several as '127.0.0.1 10.0.0.2:5556' to multi-table): ";
+    serverIPs = readLine();
+    std::cout << "Enter your player name (or 'watch' to spectate): ";
+    playerName = readLine();
+    bool spectating = playerName == "watch";
+
+    // One session per "host[:port]"
+    std::stringstream list(serverIPs);
+    std::string address;
+    while (list >> address) {
+        Session s;
+        s.id = (int)g_sessions.size() + 1;
+        size_t colon = address.find(':');
+        std::string host = address.substr(0, colon);
+        int port = colon == std::string::npos ? PORT : std::atoi(address.c_str() + colon + 1);
+        s.label = host + ":" + std::to_string(port);
+        s.spectating = spectating;
+        if (!openSession(s, host, port, playerName)) return -1;
+        g_sessions.push_back(std::move(s));
+    }
+    if (g_sessions.empty()) {
+        std::cout << "Invalid address.\n"; return -1;
+    }
+
+    std::cout << "Connected! Waiting for game to start..." << std::endl;
+    if (g_sessions.size() > 1) {
+        std::cout << "Playing " << g_sessions.size() << " tables. Type '/t <n>' to switch tables, '/tables' to list them." << std::endl;
+    }
+    if (spectating) {
+        std::cout << "Spectating. Press Ctrl+D to leave." << std::endl;
+    } else {
+        std::cout << "Type '/chat <msg>' to chat." << std::endl;
+        std::cout << "Type 'FOLD', 'CALL', 'CHECK', or 'RAISE <amount>' when it's your turn." << std::endl;
     }
 
-    CLOSESOCK(g_sock);
+    // The equity overlay, for players
+    std::thread equity;
+    if (!spectating) {
+#ifdef _WIN32
+        g_tty = _isatty(_fileno(stdout));
+#else
+        g_tty = isatty(STDOUT_FILENO);
+        if (pipe(g_wakePipe) == 0) {
+            fcntl(g_wakePipe[0], F_SETFL, O_NONBLOCK);
+            fcntl(g_wakePipe[1], F_SETFL, O_NONBLOCK);
+        }
+#endif
+        equity = std::thread(equityWorker);
+    }
+
+    // Whatever arrived with the handshake
+    for (auto& s : g_sessions) drainInbox(s);
+    runEventLoop();
+    {
+        std::lock_guard<std::mutex> lock(g_equityMutex);
+        g_equityStop = true;
+    }
+    g_equityWork.notify_all();
+    if (equity.joinable()) equity.join();
+
+    for (auto& s : g_sessions) {
+        if (s.sock != INVALID_SOCKET_VAL) CLOSESOCK(s.sock);
+    }
 #ifdef _WIN32
     WSACleanup();
 #endif
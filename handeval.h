@@ -0,0 +1,145 @@
+// ===== Fast Hand Evaluator =====
+// Shared by the server (AI equity, self-play) and the client (equity
+// overlay), so both rank hands the same way. A hand is a 52-bit mask with
+// bit suit * 13 + value - 2 set per card, so each suit is a 13-bit rank
+// field. Rank counts come from adding the four suit fields bit-sliced;
+// flushes and straights are table lookups on those fields. A higher rank is
+// a better hand. The lookup tables are built by the compiler and live in the
+// binary's read-only data, so they cost nothing at startup and are shared
+// between processes through the page cache.
+#ifndef HANDEVAL_H
+#define HANDEVAL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define RANK_FIELD_MASK 0x1FFF // One suit's 13 ranks in a hand mask
+
+// Hand orderings. Each game names one; see Game Variants in server.cpp.
+struct StandardRanking {
+    static constexpr int aceLow = 1; // Rank the ace plays as in the lowest straight (A-2-3-4-5)
+    static constexpr long long flush = 5000000000000LL;
+    static constexpr long long fullHouse = 6000000000000LL;
+};
+
+struct ShortDeckRanking {
+    static constexpr int aceLow = 5; // A-6-7-8-9
+    static constexpr long long flush = 6000000000000LL; // Flushes are rarer than full houses
+    static constexpr long long fullHouse = 5000000000000LL;
+};
+
+inline uint64_t cardBit(uint8_t code) { return 1ULL << code; }
+
+struct EvalTables {
+    int32_t bits[1 << 13];     // Set bits in a rank field
+    int32_t straight[1 << 13]; // High card of the best straight in a field, 0 if none
+};
+
+// aceLow: the rank the ace also plays as (1 for A-2-3-4-5).
+static constexpr EvalTables buildEvalTables(int aceLow) {
+    EvalTables e{};
+    for (int m = 0; m < (1 << 13); ++m) {
+        int n = 0;
+        for (int b = 0; b < 13; ++b) n += (m >> b) & 1;
+        e.bits[m] = n;
+        int wheel = (m & (1 << 12)) ? (m << 1) | (1 << (aceLow - 1)) : m << 1; // Bit v - 1 = rank v
+        for (int top = 13; top >= 4; --top) {
+            int run = 0x1F << (top - 4);
+            if ((wheel & run) == run) { e.straight[m] = top + 1; break; }
+        }
+    }
+    return e;
+}
+
+template <class R>
+inline constexpr EvalTables g_eval = buildEvalTables(R::aceLow);
+
+// Per-hand rank fields: c1/c2/c4 are the bits of each rank's count.
+struct RankFields {
+    uint32_t c1, c2, c4, ranks, flush;
+    int32_t straight, straightFlush;
+};
+
+inline int topRank(uint32_t field) { return 31 - __builtin_clz(field) + 2; }
+inline uint32_t dropRank(uint32_t field, int v) { return field & ~(1u << (v - 2)); }
+
+// Kicker score of the top n ranks in a field.
+static inline long long topKickers(uint32_t field, int n) {
+    long long s = 0, m = 100000000;
+    for (int i = 0; i < 5 - n; ++i) m /= 100;
+    for (int i = 0; i < n && field; ++i) {
+        int v = topRank(field);
+        s += v * m;
+        m /= 100;
+        field = dropRank(field, v);
+    }
+    return s;
+}
+
+template <class R>
+static long long finishRank(const RankFields& f) {
+    if (f.straightFlush) {
+        if (f.straightFlush == 14) return static_cast<long long>(9e12);
+        return static_cast<long long>(8e12) + f.straightFlush;
+    }
+    if (f.c4) {
+        int q = topRank(f.c4);
+        return static_cast<long long>(7e12) + q * 100 + topRank(dropRank(f.ranks, q));
+    }
+    uint32_t trips = f.c2 & f.c1;
+    uint32_t pairs = f.c2 & ~f.c1;
+    if (R::flush > R::fullHouse && f.flush) return R::flush + topKickers(f.flush, 5);
+    if (trips) {
+        int t = topRank(trips);
+        uint32_t rest = dropRank(trips, t) | pairs;
+        if (rest) return R::fullHouse + t * 100 + topRank(rest);
+    }
+    if (f.flush) return R::flush + topKickers(f.flush, 5);
+    if (f.straight) return static_cast<long long>(4e12) + f.straight;
+    if (trips) {
+        int t = topRank(trips);
+        return static_cast<long long>(3e12) + t * 10000 + topKickers(dropRank(f.ranks, t), 2);
+    }
+    if (pairs) {
+        int p0 = topRank(pairs);
+        uint32_t lower = dropRank(pairs, p0);
+        if (lower) {
+            int p1 = topRank(lower);
+            return static_cast<long long>(2e12) + p0 * 10000 + p1 * 100 + topRank(dropRank(dropRank(f.ranks, p0), p1));
+        }
+        return static_cast<long long>(1e12) + p0 * 1000000 + topKickers(dropRank(f.ranks, p0), 3);
+    }
+    return topKickers(f.ranks, 5);
+}
+
+template <class R>
+static void rankFields(uint64_t hand, RankFields& f) {
+    uint32_t s[4];
+    for (int k = 0; k < 4; ++k) s[k] = (uint32_t)(hand >> (13 * k)) & RANK_FIELD_MASK;
+    // Add the four suit fields bit by bit: two half adders, then the carries.
+    uint32_t a1 = s[0] ^ s[1], a2 = s[0] & s[1];
+    uint32_t b1 = s[2] ^ s[3], b2 = s[2] & s[3];
+    uint32_t carry = a1 & b1, t = a2 ^ b2;
+    f.c1 = a1 ^ b1;
+    f.c2 = t ^ carry;
+    f.c4 = (a2 & b2) | (t & carry);
+    f.ranks = s[0] | s[1] | s[2] | s[3];
+    f.flush = 0;
+    for (int k = 0; k < 4; ++k) {
+        if (g_eval<R>.bits[s[k]] >= 5) f.flush = s[k];
+    }
+    f.straight = g_eval<R>.straight[f.ranks];
+    f.straightFlush = g_eval<R>.straight[f.flush];
+}
+
+// Ranks n hand masks of five to seven cards into out.
+template <class R>
+static void rankHandsBatch(const uint64_t* hands, size_t n, long long* out) {
+    RankFields f;
+    for (size_t i = 0; i < n; ++i) {
+        rankFields<R>(hands[i], f);
+        out[i] = finishRank<R>(f);
+    }
+}
+
+#endif
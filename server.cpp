@@ -7,15 +7,37 @@
 #include <random>
 #include <map>      // For hand evaluator
 #include <set>      // For hand evaluator
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <memory_resource>
 #include <sstream>
 #ifndef _WIN32
 #include <netinet/in.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
 #endif
 #include <queue>
+#include <deque>
+#include <string_view>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <limits> // For std::numeric_limits
+#include <cmath>
 #include <cstdio> 
+#include <atomic>
+#include <cstring>
+#include <cstddef>
 #include <signal.h>
 #include <errno.h>
 
@@ -25,33 +47,91 @@
 #pragma comment(lib, "Ws2_32.lib")
 #endif
 
+#include "handeval.h"
+
 #ifdef _WIN32
 using socket_t = SOCKET;
 #define READSOCK(s,b,l) recv((SOCKET)(s), (char*)(b), (int)(l), 0)
 #define CLOSESOCK(s) closesocket((SOCKET)(s))
+#define SHUTSOCK(s) shutdown((SOCKET)(s), SD_BOTH)
 #define INVALID_SOCKET_VAL INVALID_SOCKET
 #else
 using socket_t = int;
 #define READSOCK(s,b,l) read((s),(b),(l))
 #define CLOSESOCK(s) close((s))
+#define SHUTSOCK(s) shutdown((s), SHUT_RDWR)
 #define INVALID_SOCKET_VAL (-1)
 #endif
 
 #define PORT 5555
-#define MAX_PLAYERS 4
+#define MAX_PLAYERS 4 // Default seats per table
+#define MAX_SEATS 10 // Hard cap for --seats
 #define STARTING_CHIPS 1000
 #define MONTE_CARLO_SIMULATIONS 2000 // Higher = slower but smarter.
 #define ANTE_AMOUNT 10
+#define SIM_DEFAULT_TABLES 64
+#define SIM_DEFAULT_HANDS 1000
+#define SIM_DEFAULT_TRIALS 200 // Per-decision budget for self-play; see MONTE_CARLO_SIMULATIONS.
+#define HH_INDEX_INTERVAL 1024 // Hands between hand-history index blocks
+#define OPP_MIN_HANDS 10 // Opponent model kicks in after this many hands
+#define OPP_TIGHT_VPIP 0.20
+#define OPP_AGGRESSIVE_PFR 0.15
+#define OPP_MIN_SPOTS 20 // Samples before a per-seat counter is trusted
+#define TURN_TIME_MS 20000 // Per-action clock for human players
+#define TIME_BANK_MS 30000 // Extra time drawn on once the action clock runs out
+#define TIMER_TICK_MS 100
+#define TIMER_WHEEL_SLOTS 512
+#define LINE_BUFFER_BYTES 512 // Longest client line; longer ones are cut
+#define LINE_POOL_CHUNK 256    // Line buffers allocated per pool chunk
+#define LOBBY_MAX_QUEUED 4096 // Unsent lobby bytes before a client that stopped reading is dropped
+#define MC_CHUNK_TRIALS 250 // Monte Carlo trials per scheduler job
+#define AI_DECISION_BUDGET_MS 1000 // Deadline for a networked AI decision's jobs
+#define SIM_DECISION_BUDGET_MS 60000 // Self-play work yields to interactive tables
+#define HAND_ARENA_BYTES (64 * 1024) // Covers a hand's transient state without overflow
+#define EVAL_BATCH 64 // Trials ranked per rankHands() call
+#define RANGE_STEPS 20 // Opponent range tables per 100% of hands
+#define RANGE_FLOOR 0.02f // Weight kept on hands outside an opponent's range
+#define RANGE_CALLER_RAISES 0.3f // Share of raising hands a pre-flop caller still holds
+#define RANGE_RANK_TRIALS 2000 // Trials per hand class when ranking pre-flop hands
+#define BLUEPRINT_BUCKETS 20 // Hand-strength buckets per street in the blueprint
+#define BLUEPRINT_RAISE_CAP 3 // Raises per street in the blueprint's abstraction
+#define BLUEPRINT_EQUITY_TRIALS 512 // Trials behind a flop or turn strength bucket
+#define BLUEPRINT_ITERATIONS 200000 // Default CFR iterations for --solve
+#define BLUEPRINT_DEAL_BATCH 4096 // Solver deals bucketed per scheduler round
+#define TRACE_BUFFER_EVENTS 65536 // Spans kept per thread; a power of two
+#define SPECTATOR_BACKLOG 256 // Table events kept for watchers; further behind gets a snapshot
+#define SPECTATOR_MAX_QUEUED (64 * 1024) // Unsent bytes before a slow watcher is collapsed to a snapshot
+#define SPECTATOR_SNDBUF (16 * 1024) // Kernel send buffer per watcher, so lag shows up in our queue
+#define WIRE_VERSION 1 // Highest binary protocol version spoken; see Wire Protocol
+#define WIRE_HEADER 3  // Frame type byte plus 16-bit payload length
+
+// A move as the betting round applies it. kind is a HandActionType, or
+// ACTION_UNKNOWN for input that names no move (treated as a fold).
+#define ACTION_UNKNOWN 0xFF
+struct PlayerAction {
+    uint8_t kind = ACTION_UNKNOWN;
+    int amount = 0; // Raise size; unused otherwise
+};
 
 // Thread-safe message queue for all client input
 struct Message {
     socket_t socket;
     std::string data;
+    uint64_t timerId = 0; // Non-zero: a turn timer expired (not client input)
+    PlayerAction move{};  // Set by a binary WF_ACTION frame; text moves stay in data
 };
 std::queue<Message> g_inbound_messages;
 std::mutex g_inbound_mutex;
+std::condition_variable g_inbound_cv;
+
+void postInbound(Message msg) {
+    {
+        std::lock_guard<std::mutex> lock(g_inbound_mutex);
+        g_inbound_messages.push(std::move(msg));
+    }
+    g_inbound_cv.notify_all();
+}
 std::mutex g_io_mutex; // For protecting std::cout
-std::mutex g_players_mutex; // For protecting players list
 
 // ===== Structures =====
 struct Card {
@@ -71,12 +151,112 @@ struct Card {
     }
 };
 
+// Card containers draw from whichever memory resource they were built with;
+// table state uses the table's HandArena.
+using CardList = std::pmr::vector<Card>;
+
+// Playing style of one AI seat. The defaults are the original bot.
+struct AIProfile {
+    const char* name = "balanced";
+    int bluffPct = 10;        // Turn/river bluff rate when half the table folds to bets
+    int semiBluffPct = 20;    // Raise rate with a strong draw and the odds to call
+    double valueBet = 0.60;   // Equity to bet when checked to
+    double valueRaise = 0.85; // Equity to raise a bet
+    double tightness = 1.0;   // Multiplier on the equity needed to call
+    bool ranges = true;       // Price equity against a modelled opponent's range
+    bool blueprint = true;    // Act from the loaded blueprint strategy, if any
+};
+
+static const AIProfile AI_PROFILES[] = {
+    {"balanced", 10, 20, 0.60, 0.85, 1.00},
+    {"tight",     5, 10, 0.65, 0.88, 1.15},
+    {"loose",    15, 30, 0.55, 0.80, 0.85},
+    {"maniac",   25, 45, 0.50, 0.75, 0.70},
+};
+
+// Parses "preset[:key=value...]", e.g. "loose:bluff=20:tightness=0.9".
+bool parseAIProfile(const std::string& spec, AIProfile& out) {
+    std::stringstream ss(spec);
+    std::string part;
+    std::getline(ss, part, ':');
+    bool found = false;
+    for (const auto& p : AI_PROFILES) {
+        if (part == p.name) {
+            out = p;
+            found = true;
+        }
+    }
+    if (!found) return false;
+    while (std::getline(ss, part, ':')) {
+        size_t eq = part.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = part.substr(0, eq);
+        double v = std::strtod(part.c_str() + eq + 1, nullptr);
+        if (key == "bluff") out.bluffPct = (int)v;
+        else if (key == "semibluff") out.semiBluffPct = (int)v;
+        else if (key == "value") out.valueBet = v;
+        else if (key == "raise") out.valueRaise = v;
+        else if (key == "tightness") out.tightness = v;
+        else if (key == "ranges") out.ranges = v != 0;
+        else if (key == "blueprint") out.blueprint = v != 0;
+        else return false;
+    }
+    return true;
+}
+
+// Comma-separated profiles, one per AI seat; the list repeats if shorter.
+bool parseAIProfiles(const std::string& list, std::vector<AIProfile>& out) {
+    std::stringstream ss(list);
+    std::string spec;
+    out.clear();
+    while (std::getline(ss, spec, ',')) {
+        AIProfile p;
+        if (!parseAIProfile(spec, p)) return false;
+        out.push_back(p);
+    }
+    return !out.empty();
+}
+
+// How Monte Carlo trials choose the opponent's hand and the runout.
+enum class EquitySampling {
+    Random,      // Independent shuffles
+    Stratified,  // One trial per equal slice of opponent hands sorted by class
+    QuasiRandom, // Randomized Halton points for the opponent hand and each runout card
+};
+
+static const char* const SAMPLING_NAMES[] = {"random", "stratified", "quasi"};
+
+bool parseSampling(const std::string& v, EquitySampling& out) {
+    for (int i = 0; i < 3; ++i) {
+        if (v == SAMPLING_NAMES[i]) {
+            out = static_cast<EquitySampling>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Which poker game a table deals; see the Game Variants section.
+enum class GameVariant { Holdem, Omaha, ShortDeck };
+
+static const char* const VARIANT_NAMES[] = {"holdem", "omaha", "shortdeck"};
+
+bool parseVariant(const std::string& v, GameVariant& out) {
+    for (int i = 0; i < 3; ++i) {
+        if (v == VARIANT_NAMES[i]) {
+            out = static_cast<GameVariant>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 struct Player {
     std::string name;
     int chips;
     bool folded;
     bool allIn;
-    std::vector<Card> hand;
+    CardList hand;
     socket_t socket;
     bool isAI;
     int currentBet;
@@ -84,9 +264,15 @@ struct Player {
     int handsPlayed = 0;
     int vpipActions = 0;
     int pfrActions = 0;
+    int timeBankMs = TIME_BANK_MS;
+    bool turnExpired = false; // Timed out; moves it sent before its next YOUR_MOVE are stale
+    uint8_t wire = 0; // Binary protocol version in use; 0 = text lines
+    AIProfile profile;
 
-    Player() : chips(STARTING_CHIPS), folded(false), allIn(false), socket(INVALID_SOCKET_VAL),
-               isAI(false), currentBet(0), isConnected(true) {}
+    Player() : Player(std::pmr::get_default_resource()) {}
+    explicit Player(std::pmr::memory_resource* mr)
+        : chips(STARTING_CHIPS), folded(false), allIn(false), hand(mr), socket(INVALID_SOCKET_VAL),
+          isAI(false), currentBet(0), isConnected(true) {}
 };
 
 struct HandResult {
@@ -94,32 +280,672 @@ struct HandResult {
     std::string name;
 };
 
-// ===== Global Variables =====
-std::vector<Player> players;
-std::vector<Card> deck;
-std::vector<Card> communityCards;
-int pot = 0;
-int currentBet = 0;
-bool g_preFlopRaiseMade = false;
+// Counters for the AI heuristics. Each "spot" counts the decisions where the
+// heuristic could fire, so frequencies are taken over real opportunities.
+struct AIStats {
+    long long decisions = 0;
+    long long bluffSpots = 0, bluffs = 0;         // Checked to on turn/river
+    long long semiBluffSpots = 0, semiBluffs = 0; // Strong draw, facing a bet, calling is +EV
+    long long facingBet = 0, folds = 0;
+    long long valueBets = 0, valueRaises = 0;
+    long long blueprint = 0; // Decisions taken from the blueprint strategy
 
-// ===== Utility Functions =====
-Player* getPlayerBySocket(socket_t socket) {
-    std::lock_guard<std::mutex> lock(g_players_mutex);
-    for (auto &p : players) {
-        if (p.socket == socket) {
-            return &p;
+    void merge(const AIStats& o) {
+        decisions += o.decisions;
+        bluffSpots += o.bluffSpots; bluffs += o.bluffs;
+        semiBluffSpots += o.semiBluffSpots; semiBluffs += o.semiBluffs;
+        facingBet += o.facingBet; folds += o.folds;
+        valueBets += o.valueBets; valueRaises += o.valueRaises;
+        blueprint += o.blueprint;
+    }
+};
+
+// What happened in one hand, in seat order, as written to the hand history.
+enum HandActionType : uint8_t { HA_FOLD = 0, HA_CHECK = 1, HA_CALL = 2, HA_RAISE = 3 };
+
+struct HandLogSeat {
+    std::string name;
+    int startStack = 0;   // Before the ante
+    int ante = 0;
+    bool isAI = false;
+    uint8_t hole[4] = {0xFF, 0xFF, 0xFF, 0xFF}; // 0xFF = no card; Omaha uses all four
+    int won = 0;          // Chips collected from the pot
+    bool showdown = false; // Still in the hand at showdown
+};
+
+struct HandLogAction {
+    uint8_t street;  // 0 = pre-flop .. 3 = river
+    uint8_t seat;
+    uint8_t type;    // HandActionType
+    bool allIn;
+    int amount;      // Chips put in by this action
+};
+
+struct HandLog {
+    uint64_t startMs = 0;
+    std::vector<HandLogSeat> seats;
+    std::vector<HandLogAction> actions;
+    std::vector<uint8_t> board;
+};
+
+class HandHistoryWriter;
+class OpponentStore;
+class ConnectionReactor;
+
+// Per-seat opponent counters, kept as struct-of-arrays so a decision reads a
+// few contiguous columns. Indexed like Table::players; bettingRound() and
+// playStreets() update them in O(1) per action.
+struct SeatStats {
+    uint32_t raises[MAX_SEATS] = {}, calls[MAX_SEATS] = {};  // Aggression factor
+    uint32_t threeBetSpots[MAX_SEATS] = {}, threeBets[MAX_SEATS] = {};
+    uint32_t cbetSpots[MAX_SEATS] = {}, cbets[MAX_SEATS] = {};
+    uint32_t facedBet[MAX_SEATS] = {}, foldedToBet[MAX_SEATS] = {};
+    uint32_t sawFlop[MAX_SEATS] = {}, showdowns[MAX_SEATS] = {}; // WTSD
+
+    // Drops a seat's counters and shifts later seats down, as vector::erase does.
+    void eraseSeat(size_t seat) {
+        uint32_t* cols[] = {raises, calls, threeBetSpots, threeBets, cbetSpots, cbets,
+                            facedBet, foldedToBet, sawFlop, showdowns};
+        for (uint32_t* c : cols) {
+            std::copy(c + seat + 1, c + MAX_SEATS, c + seat);
+            c[MAX_SEATS - 1] = 0;
+        }
+    }
+};
+
+// ===== Seat Registry =====
+// Handle to a seated player. It keeps resolving while other players come and
+// go, and resolves to nullptr once its own player has been removed.
+struct SeatHandle {
+    uint8_t slot = 0xFF;
+    uint32_t gen = 0;
+    bool valid() const { return slot != 0xFF; }
+};
+
+// Slot map holding a table's players in seat order. Storage is a fixed array,
+// so a join from the accept thread never moves a Player the game thread is
+// holding; only erase() (between hands) shifts later seats down. Handles go
+// through a slot indirection with a generation per slot.
+class SeatMap {
+public:
+    // Hole cards of every seat are allocated from mr.
+    explicit SeatMap(std::pmr::memory_resource* mr) : m_players(reinterpret_cast<Player*>(m_storage)), m_mr(mr) {
+        for (int i = 0; i < MAX_SEATS; ++i) {
+            new (&m_players[i]) Player(mr);
+            m_gen[i] = 1;
+        }
+    }
+
+    ~SeatMap() {
+        for (int i = 0; i < MAX_SEATS; ++i) m_players[i].~Player();
+    }
+
+    SeatMap(const SeatMap&) = delete;
+    SeatMap& operator=(const SeatMap&) = delete;
+
+    Player* begin() { return m_players; }
+    Player* end() { return m_players + size(); }
+    const Player* begin() const { return m_players; }
+    const Player* end() const { return m_players + size(); }
+    Player* data() { return m_players; }
+    const Player* data() const { return m_players; }
+    size_t size() const { return m_size.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    Player& operator[](size_t i) { return m_players[i]; }
+    const Player& operator[](size_t i) const { return m_players[i]; }
+
+    // Returns an invalid handle when all MAX_SEATS seats are taken.
+    SeatHandle push_back(Player p) {
+        size_t n = m_size.load(std::memory_order_relaxed);
+        if (n >= MAX_SEATS || !m_freeMask) return SeatHandle();
+        uint8_t slot = 0;
+        while (!((m_freeMask >> slot) & 1)) slot++;
+        m_freeMask &= ~(1u << slot);
+        m_players[n] = std::move(p);
+        m_slotOf[n] = slot;
+        m_denseOf[slot] = (uint8_t)n;
+        m_size.store(n + 1, std::memory_order_release);
+        return {slot, m_gen[slot]};
+    }
+
+    // Keeps the remaining players in seat order.
+    Player* erase(Player* it) {
+        size_t n = size();
+        size_t i = it - m_players;
+        uint8_t slot = m_slotOf[i];
+        m_gen[slot]++;
+        m_freeMask |= 1u << slot;
+        for (size_t j = i; j + 1 < n; ++j) {
+            m_players[j] = std::move(m_players[j + 1]);
+            m_slotOf[j] = m_slotOf[j + 1];
+            m_denseOf[m_slotOf[j]] = (uint8_t)j;
+        }
+        // Rebuild rather than assign: assignment would keep any arena buffer.
+        m_players[n - 1].~Player();
+        new (&m_players[n - 1]) Player(m_mr);
+        m_size.store(n - 1, std::memory_order_release);
+        return it;
+    }
+
+    // Freeing a slot bumps its generation, so a stale handle fails the check.
+    Player* get(SeatHandle h) {
+        if (!h.valid() || h.slot >= MAX_SEATS || m_gen[h.slot] != h.gen) return nullptr;
+        return &m_players[m_denseOf[h.slot]];
+    }
+
+    SeatHandle handleOf(const Player& p) const {
+        uint8_t slot = m_slotOf[&p - m_players];
+        return {slot, m_gen[slot]};
+    }
+
+private:
+    alignas(Player) unsigned char m_storage[sizeof(Player) * MAX_SEATS];
+    Player* m_players;
+    std::pmr::memory_resource* m_mr;
+    std::atomic<size_t> m_size{0};
+    uint8_t m_slotOf[MAX_SEATS] = {};  // Seat index -> slot
+    uint8_t m_denseOf[MAX_SEATS] = {}; // Slot -> seat index
+    uint32_t m_gen[MAX_SEATS];
+    uint32_t m_freeMask = (1u << MAX_SEATS) - 1;
+};
+
+// Process-wide map from a connection (socket) to the table and seat it is
+// bound to. Sockets are small integers on POSIX, so this is a direct-indexed
+// array of packed entries, allocated in chunks on first use and read without
+// locking. Entry layout: table id (24 bits) | slot (8) | generation (32).
+class ConnectionIndex {
+public:
+    ~ConnectionIndex() {
+        for (auto& c : m_chunks) delete[] c.load();
+    }
+
+    void bind(socket_t s, uint32_t table, SeatHandle h) {
+        std::atomic<uint64_t>* e = entry(s, true);
+        if (e) e->store(pack(table, h), std::memory_order_release);
+    }
+
+    // Only clears the entry if the socket is still bound to this seat.
+    void unbind(socket_t s, uint32_t table, SeatHandle h) {
+        std::atomic<uint64_t>* e = entry(s, false);
+        uint64_t expected = pack(table, h);
+        if (e) e->compare_exchange_strong(expected, 0);
+    }
+
+    bool find(socket_t s, uint32_t& table, SeatHandle& h) const {
+        std::atomic<uint64_t>* e = const_cast<ConnectionIndex*>(this)->entry(s, false);
+        uint64_t v = e ? e->load(std::memory_order_acquire) : 0;
+        if (!v) return false;
+        table = (uint32_t)(v >> 40);
+        h.slot = (uint8_t)(v >> 32);
+        h.gen = (uint32_t)v;
+        return true;
+    }
+
+private:
+    static const size_t CHUNK = 4096;
+    static const size_t MAX_CHUNKS = 1024; // Covers 4M descriptors
+    std::atomic<std::atomic<uint64_t>*> m_chunks[MAX_CHUNKS] = {};
+
+    static uint64_t pack(uint32_t table, SeatHandle h) {
+        return ((uint64_t)(table & 0xFFFFFF) << 40) | ((uint64_t)h.slot << 32) | h.gen;
+    }
+
+    std::atomic<uint64_t>* entry(socket_t s, bool create) {
+        size_t key = (size_t)s;
+        if (s == INVALID_SOCKET_VAL || key / CHUNK >= MAX_CHUNKS) return nullptr;
+        std::atomic<std::atomic<uint64_t>*>& slot = m_chunks[key / CHUNK];
+        std::atomic<uint64_t>* chunk = slot.load(std::memory_order_acquire);
+        if (!chunk && create) {
+            std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[CHUNK]();
+            if (slot.compare_exchange_strong(chunk, fresh)) {
+                chunk = fresh;
+            } else {
+                delete[] fresh; // Another thread installed it first
+            }
         }
+        return chunk ? &chunk[key % CHUNK] : nullptr;
+    }
+};
+
+ConnectionIndex g_connections;
+std::atomic<uint32_t> g_nextTableId{1};
+
+// ===== Hand Arena =====
+// Per-table memory for one hand's transient state: the deck, the board and
+// the hole cards. Allocating is a pointer bump in a buffer the table keeps,
+// and reset() frees the whole hand in one step. Overflow is served by a pool
+// that keeps its blocks, so steady-state play does not touch the heap.
+class HandArena {
+public:
+    HandArena()
+        : m_buffer(new std::byte[HAND_ARENA_BYTES]),
+          m_arena(m_buffer.get(), HAND_ARENA_BYTES, &m_overflow) {}
+
+    std::pmr::memory_resource* resource() { return &m_arena; }
+    void reset() { m_arena.release(); }
+
+private:
+    std::unique_ptr<std::byte[]> m_buffer;
+    std::pmr::unsynchronized_pool_resource m_overflow;
+    std::pmr::monotonic_buffer_resource m_arena;
+};
+
+// ===== Random Streams =====
+// Every random choice draws from a CounterRng. Draw n of a stream is a hash
+// of (key, n), so a stream is two words with no warm-up, and any number of
+// them open from one master seed without coordination. Keys are derived down
+// a tree: seed -> table -> hand -> deal or AI, and each Monte Carlo chunk
+// keys off its decision and its index. A run with a fixed --seed therefore
+// deals, simulates and decides the same way whatever the thread count, and a
+// hand's cards and AI rolls do not depend on earlier hands. Bounded draws and
+// shuffles are done here rather than with <random> distributions, whose
+// output differs between standard libraries.
+static inline uint64_t mix64(uint64_t z) { // SplitMix64 finalizer
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static const uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+
+// Key of child stream `tag` under `parent`.
+static inline uint64_t deriveKey(uint64_t parent, uint64_t tag) {
+    return mix64(parent ^ mix64(tag + GOLDEN_GAMMA));
+}
+
+enum RngStream : uint64_t { RNG_DEAL = 1, RNG_AI = 2 };
+
+class CounterRng {
+public:
+    using result_type = uint32_t;
+
+    explicit CounterRng(uint64_t key = 0) : m_key(key) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+    result_type operator()() { return (result_type)(next64() >> 32); }
+    uint64_t next64() { return mix64(m_key + ++m_counter * GOLDEN_GAMMA); }
+
+    // Uniform in [0, n) by multiply-shift; the bias is below n / 2^32.
+    uint32_t below(uint32_t n) { return (uint32_t)(((uint64_t)(*this)() * n) >> 32); }
+    // Uniform in [0, 1); 32 bits are plenty to pick among 52 cards.
+    double unit() { return (*this)() * (1.0 / 4294967296.0); }
+
+private:
+    uint64_t m_key;
+    uint64_t m_counter = 0;
+};
+
+// A fresh master seed for runs that did not ask for one.
+static uint64_t randomSeed() {
+    std::random_device rd;
+    return ((uint64_t)rd() << 32) | rd();
+}
+
+// ===== Tracing =====
+// Scoped spans over the hand lifecycle (ante, deal, betting rounds,
+// decisions, showdown, broadcasts, Monte Carlo chunks). Each thread records
+// into its own ring of the last TRACE_BUFFER_EVENTS spans: a span is a few
+// relaxed stores and one release of the ring's head, with no lock and no
+// allocation. writeChromeTrace() copies every ring and writes Chrome trace
+// JSON, which chrome://tracing and the Perfetto UI both open. With tracing
+// off a span is one relaxed load.
+std::atomic<bool> g_traceEnabled{false};
+
+static inline uint64_t traceNow() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct TraceEvent {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<const char*> argName{nullptr}; // nullptr = no argument
+    std::atomic<uint64_t> start{0}, duration{0};
+    std::atomic<int> arg{0};
+};
+
+struct TraceBuffer {
+    std::string threadName;
+    int tid = 0;
+    std::atomic<uint64_t> head{0};    // Spans ever recorded; the ring keeps the last TRACE_BUFFER_EVENTS
+    std::atomic<uint64_t> claimed{0}; // Raised before a slot is overwritten, so readers can spot it
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[TRACE_BUFFER_EVENTS]};
+};
+
+// Buffers are created on a thread's first span and kept until exit, so a
+// dump can still read threads that have finished.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    uint64_t epoch = traceNow(); // Timestamps in the dump are relative to this
+};
+
+static TraceRegistry& traceRegistry() {
+    static TraceRegistry r;
+    return r;
+}
+
+static thread_local const char* t_traceThreadName = nullptr;
+
+// Names this thread in dumps; call before its first span.
+static void traceThreadName(const char* name) {
+    t_traceThreadName = name;
+}
+
+static TraceBuffer& traceBuffer() {
+    static thread_local TraceBuffer* buf = nullptr;
+    if (!buf) {
+        TraceRegistry& r = traceRegistry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffers.push_back(std::make_unique<TraceBuffer>());
+        buf = r.buffers.back().get();
+        buf->tid = (int)r.buffers.size();
+        buf->threadName = t_traceThreadName ? t_traceThreadName : "thread " + std::to_string(buf->tid);
     }
-    return nullptr;
+    return *buf;
 }
 
-Player* getHumanOpponent() {
-    for (auto& p : players) {
-        if (!p.isAI && !p.folded && p.isConnected) {
-            return &p;
+static void traceRecord(const char* name, uint64_t start, uint64_t duration, const char* argName, int arg) {
+    TraceBuffer& b = traceBuffer();
+    uint64_t h = b.head.load(std::memory_order_relaxed);
+    b.claimed.store(h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& e = b.events[h & (TRACE_BUFFER_EVENTS - 1)];
+    e.name.store(name, std::memory_order_relaxed);
+    e.argName.store(argName, std::memory_order_relaxed);
+    e.start.store(start, std::memory_order_relaxed);
+    e.duration.store(duration, std::memory_order_relaxed);
+    e.arg.store(arg, std::memory_order_relaxed);
+    b.head.store(h + 1, std::memory_order_release);
+}
+
+// Records the enclosing scope. Names must be string literals.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, int arg = 0)
+        : m_name(g_traceEnabled.load(std::memory_order_relaxed) ? name : nullptr), m_argName(argName), m_arg(arg) {
+        if (m_name) m_start = traceNow();
+    }
+    ~TraceSpan() {
+        if (m_name) traceRecord(m_name, m_start, traceNow() - m_start, m_argName, m_arg);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_argName;
+    int m_arg;
+    uint64_t m_start = 0;
+};
+
+// Writes every thread's recorded spans; safe while threads keep tracing.
+// A span the writer overwrote during the copy is dropped rather than torn.
+bool writeChromeTrace(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    TraceRegistry& r = traceRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& bp : r.buffers) {
+        const TraceBuffer& b = *bp;
+        std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", b.tid, b.threadName.c_str());
+        first = false;
+        uint64_t end = b.head.load(std::memory_order_acquire);
+        uint64_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+        struct Copy { const char* name; const char* argName; uint64_t start, duration; int arg; };
+        std::vector<Copy> spans;
+        spans.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            const TraceEvent& e = b.events[i & (TRACE_BUFFER_EVENTS - 1)];
+            spans.push_back({e.name.load(std::memory_order_relaxed), e.argName.load(std::memory_order_relaxed),
+                             e.start.load(std::memory_order_relaxed), e.duration.load(std::memory_order_relaxed),
+                             e.arg.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = b.claimed.load(std::memory_order_relaxed);
+        uint64_t valid = now >= TRACE_BUFFER_EVENTS ? now - TRACE_BUFFER_EVENTS + 1 : 0; // Slots the writer may be reusing
+        for (uint64_t i = std::max(begin, valid); i < end; ++i) {
+            const Copy& c = spans[i - begin];
+            std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                         c.name, b.tid, (double)(int64_t)(c.start - r.epoch) / 1000.0, c.duration / 1000.0);
+            if (c.argName) std::fprintf(f, ",\"args\":{\"%s\":%d}", c.argName, c.arg);
+            std::fputc('}', f);
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
+
+static void dumpTrace(const std::string& path) {
+    bool ok = writeChromeTrace(path);
+    std::lock_guard<std::mutex> lock(g_io_mutex);
+    if (ok) std::cout << "Trace written to " << path << std::endl;
+    else std::cerr << "Cannot write trace " << path << std::endl;
+}
+
+// ===== Wire Protocol =====
+// Text clients send their name as the first line and get newline-delimited
+// text. A client that opens with "PROTO <version> <name>" is answered with
+// "PROTO <v>\n", v being the highest version both sides speak, and from then
+// on both directions carry length-prefixed frames: a type byte, a 16-bit
+// payload length and the payload. Each type has one fixed layout, so a reader
+// dispatches on the type byte and never searches message text. Integers are
+// big-endian u32 and names carry a length byte. v = 0 stays on text.
+enum WireFrame : uint8_t {
+    WF_TEXT = 1,          // Untyped message: UTF-8 lines without the last newline
+    WF_ACTION = 2,        // kind (HandActionType), all-in flag, amount called or raised by, name. To the server: kind, amount
+    WF_STATE = 3,         // pot, seat count u8, then each seat changed since the last: seat u8, flags, chips, name
+    WF_HOLE = 4,          // Card codes (suit * 13 + value - 2), one byte each
+    WF_BOARD = 5,         // Card codes
+    WF_CHAT = 6,          // name, text. To the server: text
+    WF_YOUR_MOVE = 7,     // to call, pot, chips behind
+    WF_SHOWDOWN = 8,      // name, card codes
+    WF_WIN = 9,           // amount, winner count u8, names, hand name (empty: last one standing)
+    WF_GAME_STARTING = 10,
+    WF_HAND_OVER = 11,
+    WF_TURN_OVER = 12,    // The player's turn timed out; moves sent for it are dropped
+    WF_GAME = 13,         // The table's game (GameVariant u8), after the welcome; clients price hands by it
+};
+
+enum WireSeatFlags : uint8_t { WS_FOLDED = 1, WS_ALL_IN = 2, WS_OFFLINE = 4 };
+
+// A seat as the last WF_STATE described it.
+struct WireSeat {
+    std::string name;
+    int chips = 0;
+    uint8_t flags = 0;
+};
+
+inline void wirePut8(std::string& f, uint8_t v) { f += (char)v; }
+
+inline void wirePut32(std::string& f, uint32_t v) {
+    char b[4] = {(char)(v >> 24), (char)(v >> 16), (char)(v >> 8), (char)v};
+    f.append(b, 4);
+}
+
+inline void wirePutName(std::string& f, const std::string& name) {
+    size_t n = std::min<size_t>(name.size(), 255);
+    wirePut8(f, (uint8_t)n);
+    f.append(name, 0, n);
+}
+
+inline uint32_t wireGet32(const char* p) {
+    const unsigned char* u = (const unsigned char*)p;
+    return (uint32_t)u[0] << 24 | (uint32_t)u[1] << 16 | (uint32_t)u[2] << 8 | u[3];
+}
+
+// Payload length from a frame header.
+inline size_t wireLength(const char* header) {
+    return (size_t)(unsigned char)header[1] << 8 | (unsigned char)header[2];
+}
+
+// Starts a frame in f; wireEnd() fills in the length once the payload is written.
+inline void wireBegin(std::string& f, uint8_t type) {
+    f.assign(WIRE_HEADER, '\0');
+    f[0] = (char)type;
+}
+
+inline void wireEnd(std::string& f) {
+    if (f.size() > WIRE_HEADER + 0xFFFF) f.resize(WIRE_HEADER + 0xFFFF);
+    size_t n = f.size() - WIRE_HEADER;
+    f[1] = (char)(n >> 8);
+    f[2] = (char)n;
+}
+
+inline void wireText(std::string& f, const std::string& text) {
+    wireBegin(f, WF_TEXT);
+    f += text;
+    wireEnd(f);
+}
+
+// ===== Spectator Feed =====
+// What a table shows to watchers: every broadcast to the seats (these never
+// carry hole cards before the showdown) plus a snapshot of the latest table
+// display. The table thread publishes each event once as an immutable shared
+// buffer, and only while someone is watching, so its cost does not grow
+// with the audience. The reactor thread hands the same buffers to every
+// watcher's queue and writes them with non-blocking sends; see
+// ConnectionReactor::pumpWatchers().
+using SharedText = std::shared_ptr<const std::string>;
+
+class SpectatorFeed {
+public:
+    std::atomic<int> watchers{0};
+    std::function<void()> onPublish; // Set by the reactor to wake itself
+
+    // Table thread; text is one or more complete lines.
+    void publish(const std::string& text) {
+        if (watchers.load(std::memory_order_relaxed) == 0) return;
+        SharedText e = std::make_shared<const std::string>(text);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_events[m_head % SPECTATOR_BACKLOG] = std::move(e);
+            m_head++;
         }
+        if (onPublish) onPublish();
+    }
+
+    void setSnapshot(std::string text) {
+        SharedText snap = std::make_shared<const std::string>(std::move(text));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_snapshot = std::move(snap);
+    }
+
+    // Table thread, while nobody watches: the next watcher starts from the
+    // following redraw instead of a stale display.
+    void dropSnapshot() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_snapshot.reset();
+    }
+
+    uint64_t head() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_head;
+    }
+
+    SharedText snapshot() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_snapshot;
+    }
+
+    // Copies the kept events from sequence `from` on into out and returns
+    // the sequence of out[0]; anything older has been overwritten.
+    uint64_t since(uint64_t from, std::vector<SharedText>& out, uint64_t& head) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        head = m_head;
+        uint64_t first = std::max(from, m_head > SPECTATOR_BACKLOG ? m_head - SPECTATOR_BACKLOG : 0);
+        out.clear();
+        for (uint64_t i = first; i < m_head; ++i) out.push_back(m_events[i % SPECTATOR_BACKLOG]);
+        return first;
     }
-    return nullptr;
+
+private:
+    std::mutex m_mutex;
+    SharedText m_events[SPECTATOR_BACKLOG];
+    uint64_t m_head = 0; // Sequence of the next event
+    SharedText m_snapshot;
+};
+
+// ===== Table State =====
+// Everything one game needs. The networked server runs a single table; the
+// self-play simulator runs many headless tables side by side, one per thread.
+struct Table {
+    uint32_t id = g_nextTableId++; // Key for g_connections
+    HandArena arena; // Declared first: the card containers below live in it
+    SeatMap players{arena.resource()};
+    CardList deck = CardList(arena.resource());
+    CardList communityCards = CardList(arena.resource());
+    int pot = 0;
+    int currentBet = 0;
+    bool preFlopRaiseMade = false;
+    int preflopRaises = 0;     // Raises so far this hand before the flop
+    int preflopAggressor = -1; // Seat of the last pre-flop raiser
+    int lastAggressor = -1;    // Seat of the last raiser this street
+    int streetRaises = 0;      // Raises so far this street
+    int streetActions = 0;     // Actions so far this street
+    int handRaises = 0;        // Raises on earlier streets this hand
+    SeatStats seatStats;
+
+    bool headless = false;  // No sockets, no console output, no delays
+    bool selfPlay = false;  // AI seats model each other as opponents
+    bool thinkDelay = true; // Show the AI "thinking" animation
+    std::atomic<bool> handInProgress{false}; // Set by the game thread, read when seating a newcomer
+    int maxSeats = MAX_PLAYERS;
+    int ante = ANTE_AMOUNT;
+    int startingChips = STARTING_CHIPS;
+    int turnTimeMs = TURN_TIME_MS;  // 0 = wait for human moves indefinitely
+    int timeBankMs = TIME_BANK_MS;  // Each new player's starting time bank
+    int simulations = MONTE_CARLO_SIMULATIONS;
+    EquitySampling sampling = EquitySampling::Random;
+    GameVariant variant = GameVariant::Holdem;
+    int decisionBudgetMs = AI_DECISION_BUDGET_MS; // Orders this table's jobs on the scheduler
+    int equityBoard = -1;          // Board size equityCache was computed for; -1 = none
+    double equityCache[MAX_SEATS] = {}; // Per-seat AI equity on that board
+    double equityError[MAX_SEATS] = {}; // Standard error of each equityCache entry
+    int equityRange[MAX_SEATS];         // Opponent range each entry was computed against; see rangeKey()
+    uint64_t seed = randomSeed(); // Root of this table's streams; see Random Streams
+    uint64_t handSeq = 0;         // Hands dealt, keys each hand's streams
+    CounterRng rng;     // AI rolls for the current hand
+    CounterRng dealRng; // Shuffles only, so the deal never depends on decisions
+    AIStats aiStats;
+    HandHistoryWriter* history = nullptr; // Set to record every hand
+    OpponentStore* models = nullptr;      // Set to persist opponent stats
+    ConnectionReactor* reactor = nullptr; // Owns client sockets and the lobby
+    HandLog handLog;
+    SpectatorFeed spectators;
+    WireSeat wireSent[MAX_SEATS]; // Seats as the last WF_STATE left them
+    size_t wireSeats = 0;         // Seats that WF_STATE covered; 0 makes the next one full
+    std::string sendBuf;    // Reused by broadcast_unsafe(); guarded by playersMutex
+    std::string wireBuf;    // WF_TEXT frame of sendBuf, built when a binary client is seated
+    std::string displayBuf; // Reused by showTable()
+
+    std::mutex playersMutex; // For protecting players list
+
+    Table() { std::fill(std::begin(equityRange), std::end(equityRange), -1); }
+};
+
+// ===== Utility Functions =====
+Player* getPlayerBySocket(Table& t, socket_t socket) {
+    uint32_t table;
+    SeatHandle h;
+    if (!g_connections.find(socket, table, h) || table != t.id) return nullptr;
+    return t.players.get(h);
+}
+
+// Opponents the AI models: live humans, or every other seat in self-play.
+bool isModelledOpponent(const Table& t, const Player& p, const Player& self) {
+    if (&p == &self || p.folded || !p.isConnected) return false;
+    return !p.isAI || t.selfPlay;
+}
+
+// Console output that headless tables swallow.
+void logLine(const Table& t, const std::string& msg) {
+    if (t.headless) return;
+    std::lock_guard<std::mutex> lock(g_io_mutex);
+    std::cout << msg << std::endl;
 }
 
 // Robust send-all helper. Returns true on success, false on failure.
@@ -138,86 +964,186 @@ static bool sendAll(socket_t sock, const char* data, size_t len) {
 }
 
 // --- UPDATED: sendAll + disconnect on failure ---
-void sendToPlayer(Player &p, const std::string &msg) {
+// frame, if given, is what a binary client gets instead of msg; otherwise
+// msg goes out to it as WF_TEXT.
+void sendToPlayer(Player &p, const std::string &msg, const std::string* frame = nullptr) {
     if (!p.isAI && p.socket != INVALID_SOCKET_VAL && p.isConnected) {
-        std::string fullMsg = msg + "\n";
+        std::string fullMsg;
+        if (!p.wire) fullMsg = msg + "\n";
+        else if (frame) fullMsg = *frame;
+        else wireText(fullMsg, msg);
         if (!sendAll(p.socket, fullMsg.c_str(), fullMsg.size())) {
             {
                 std::lock_guard<std::mutex> lock(g_io_mutex);
                 std::cout << "[Network] Failed to send to " << p.name << " (disconnecting)" << std::endl;
             }
             p.isConnected = false;
-            {
-                std::lock_guard<std::mutex> lock(g_inbound_mutex);
-                g_inbound_messages.push({p.socket, "DISCONNECTED"});
-            }
-            CLOSESOCK(p.socket);
-            p.socket = INVALID_SOCKET_VAL;
+            // The reactor sees the hangup and reports DISCONNECTED; the socket
+            // is closed once the seat is released.
+            SHUTSOCK(p.socket);
         }
     }
 }
 
-void broadcast_unsafe(const std::string &msg) {
-    std::string fullMsg = msg + "\n";
-    for (auto &p : players) {
+// Binary clients get frame, or msg as WF_TEXT when there is none.
+void broadcast_unsafe(Table& t, const std::string &msg, const std::string* frame = nullptr) {
+    if (t.headless) return;
+    TraceSpan span("broadcast");
+    std::string& fullMsg = t.sendBuf;
+    fullMsg.assign(msg);
+    fullMsg += '\n';
+    t.spectators.publish(fullMsg);
+    for (auto &p : t.players) {
         if (!p.isAI && p.socket != INVALID_SOCKET_VAL && p.isConnected) {
-            if (!sendAll(p.socket, fullMsg.c_str(), fullMsg.size())) {
+            const std::string* out = &fullMsg;
+            if (p.wire) {
+                if (!frame) {
+                    wireText(t.wireBuf, msg);
+                    frame = &t.wireBuf;
+                }
+                out = frame;
+            }
+            if (!sendAll(p.socket, out->data(), out->size())) {
                 {
                     std::lock_guard<std::mutex> lock(g_io_mutex);
                     std::cout << "[Network] Failed to broadcast to " << p.name << " (disconnecting)" << std::endl;
                 }
                 p.isConnected = false;
-                {
-                    std::lock_guard<std::mutex> lock(g_inbound_mutex);
-                    g_inbound_messages.push({p.socket, "DISCONNECTED"});
-                }
-                CLOSESOCK(p.socket);
-                p.socket = INVALID_SOCKET_VAL;
+                SHUTSOCK(p.socket);
             }
         }
     }
 }
 
-void broadcast(const std::string &msg) {
-    std::lock_guard<std::mutex> lock(g_players_mutex);
-    broadcast_unsafe(msg);
+void broadcast(Table& t, const std::string &msg, const std::string* frame = nullptr) {
+    if (t.headless) return;
+    std::lock_guard<std::mutex> lock(t.playersMutex);
+    broadcast_unsafe(t, msg, frame);
 }
 
-void broadcastChat(const std::string &playerName, const std::string &message) {
+void broadcastChat(Table& t, const std::string &playerName, const std::string &message) {
     std::string msg = "CHAT:" + playerName + ":" + message;
-    broadcast(msg);
+    std::string frame;
+    wireBegin(frame, WF_CHAT);
+    wirePutName(frame, playerName);
+    frame += message;
+    wireEnd(frame);
+    broadcast(t, msg, &frame);
     std::lock_guard<std::mutex> lock(g_io_mutex);
     std::cout << "[CHAT] " << playerName << ": " << message << std::endl;
 }
 
+// ===== Game Variants =====
+// Each game is a compile-time policy: hole cards dealt, how many of them a
+// hand must use (0 = any five of all cards), the deck's lowest rank, and the
+// hand ordering. The evaluators and the Monte Carlo loop are templates over
+// the policy, so every game gets its own specialized hot loop; a table picks
+// its game at runtime and withVariant() crosses into the templates once per
+// call. Ranking policies (StandardRanking, ShortDeckRanking) come from
+// handeval.h and are shared: Omaha ranks its five-card hands exactly as
+// Hold'em does.
+struct Holdem {
+    using Ranking = StandardRanking;
+    static constexpr GameVariant id = GameVariant::Holdem;
+    static constexpr int holeCards = 2;
+    static constexpr int mustUse = 0;
+    static constexpr int lowRank = 2;
+};
+
+struct Omaha {
+    using Ranking = StandardRanking;
+    static constexpr GameVariant id = GameVariant::Omaha;
+    static constexpr int holeCards = 4;
+    static constexpr int mustUse = 2; // Exactly two hole cards and three from the board
+    static constexpr int lowRank = 2;
+};
+
+struct ShortDeck {
+    using Ranking = ShortDeckRanking;
+    static constexpr GameVariant id = GameVariant::ShortDeck;
+    static constexpr int holeCards = 2;
+    static constexpr int mustUse = 0;
+    static constexpr int lowRank = 6; // 36 cards, sixes to aces
+};
+
+// Calls f with a default-constructed policy object for the table's game.
+template <class F>
+decltype(auto) withVariant(GameVariant v, F&& f) {
+    switch (v) {
+    case GameVariant::Omaha: return f(Omaha{});
+    case GameVariant::ShortDeck: return f(ShortDeck{});
+    default: return f(Holdem{});
+    }
+}
+
+inline int variantHoleCards(GameVariant v) {
+    return withVariant(v, [](auto g) { return decltype(g)::holeCards; });
+}
+
+// Card codes (see cardCode()) in the game's deck.
+constexpr uint64_t deckMask(int lowRank) {
+    uint64_t suit = ((1ULL << 13) - 1) & ~((1ULL << (lowRank - 2)) - 1);
+    return suit | suit << 13 | suit << 26 | suit << 39;
+}
+
+constexpr int binomial(int n, int k) { return k == 0 ? 1 : binomial(n - 1, k - 1) * n / k; }
+
+// The K-element subsets of N positions, as bitmasks.
+template <int N, int K>
+struct Subsets {
+    static constexpr int count = binomial(N, K);
+    uint8_t masks[count] = {};
+    constexpr Subsets() {
+        int c = 0;
+        for (int m = 0; m < (1 << N); ++m) {
+            int bits = 0;
+            for (int b = 0; b < N; ++b) bits += (m >> b) & 1;
+            if (bits == K) masks[c++] = (uint8_t)m;
+        }
+    }
+};
+
 // ===== Deck & Cards =====
-std::vector<Card> getFullDeck() {
-    std::vector<Card> d;
-    std::vector<std::string> s{"♥", "♦", "♣", "♠"};
-    std::vector<std::string> r{"2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K", "A"};
-    for (auto& suit : s) {
-        for (auto& rank : r) {
-            d.push_back({rank, suit});
+// Every card from lowRank up to the ace, in cardCode() order.
+CardList getFullDeck(std::pmr::memory_resource* mr = std::pmr::get_default_resource(), int lowRank = 2) {
+    static const char* s[] = {"♥", "♦", "♣", "♠"};
+    static const char* r[] = {"2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K", "A"};
+    CardList d(mr);
+    d.reserve(4 * (15 - lowRank));
+    for (auto suit : s) {
+        for (int i = lowRank - 2; i < 13; ++i) {
+            d.push_back({r[i], suit});
         }
     }
     return d;
 }
 
-void createDeck() {
-    deck = getFullDeck();
+void createDeck(Table& t) {
+    int lowRank = withVariant(t.variant, [](auto g) { return decltype(g)::lowRank; });
+    t.deck = getFullDeck(t.arena.resource(), lowRank);
 }
 
-void shuffleDeck() {
-    std::shuffle(deck.begin(), deck.end(), std::mt19937(std::random_device{}()));
+void shuffleDeck(Table& t) {
+    for (size_t i = t.deck.size(); i > 1; --i) std::swap(t.deck[i - 1], t.deck[t.dealRng.below((uint32_t)i)]);
 }
 
-Card drawCard() {
-    Card c = deck.back();
-    deck.pop_back();
+Card drawCard(Table& t) {
+    Card c = t.deck.back();
+    t.deck.pop_back();
     return c;
 }
 
-std::string displayCards(const std::vector<Card> &cards) {
+// Cards separated by spaces: "AH 10D" for clients, or with suit symbols for the console.
+std::string handText(const CardList& cards, bool console) {
+    std::string out;
+    for (const auto& c : cards) {
+        if (!out.empty()) out += " ";
+        out += console ? c.rank + c.suit : c.toString();
+    }
+    return out;
+}
+
+std::string displayCards(const CardList &cards) {
     std::stringstream ss;
     for (int l = 0; l < 5; l++) {
         for (auto& c : cards) {
@@ -241,6 +1167,26 @@ int getCardValue(const std::string& r) {
     return std::stoi(r);
 }
 
+// Compact card code used on disk: suit * 13 + (value - 2), matching getFullDeck() order.
+uint8_t cardCode(const Card& c) {
+    int s = 0;
+    if (c.suit == "♦") s = 1;
+    else if (c.suit == "♣") s = 2;
+    else if (c.suit == "♠") s = 3;
+    return static_cast<uint8_t>(s * 13 + getCardValue(c.rank) - 2);
+}
+
+void wirePutCards(std::string& f, const CardList& cards) {
+    for (const auto& c : cards) wirePut8(f, cardCode(c));
+}
+
+Card cardFromCode(uint8_t code) {
+    static const char* suits[] = {"♥", "♦", "♣", "♠"};
+    static const char* ranks[] = {"2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K", "A"};
+    if (code >= 52) return {"?", "?"};
+    return {ranks[code % 13], suits[code / 13]};
+}
+
 std::string getRankName(int v) {
     if (v == 14) return "Ace";
     if (v == 13) return "King";
@@ -261,6 +1207,7 @@ long long getKickerScore(const std::vector<int>& k) {
     return s;
 }
 
+template <class R>
 HandResult evaluate5CardHand(std::vector<Card>& h) {
     if (h.size() != 5) return {0, "Invalid"};
 
@@ -281,10 +1228,11 @@ HandResult evaluate5CardHand(std::vector<Card>& h) {
         if (r[i] != r[i + 1] + 1) t = false;
     }
     
-    // A-5 Straight check
-    if (!t && r[0] == 14 && r[1] == 5 && r[2] == 4 && r[3] == 3 && r[4] == 2) {
+    // Low straight: the ace plays below the deck's lowest rank (A-5, or A-9 short-deck)
+    const int low = R::aceLow;
+    if (!t && r[0] == 14 && r[1] == low + 4 && r[2] == low + 3 && r[3] == low + 2 && r[4] == low + 1) {
         t = true;
-        r = {5, 4, 3, 2, 1}; 
+        r = {low + 4, low + 3, low + 2, low + 1, low};
     }
 
     if (t && f) {
@@ -311,10 +1259,10 @@ HandResult evaluate5CardHand(std::vector<Card>& h) {
         return {static_cast<long long>(7e12) + (foak * 100) + k[0], "Four of a Kind (" + getRankName(foak) + "s)"};
     }
     if (toak > 0 && p.size() > 0) {
-        return {static_cast<long long>(6e12) + (toak * 100) + p[0], "a Full House (" + getRankName(toak) + "s full of " + getRankName(p[0]) + "s)"};
+        return {R::fullHouse + (toak * 100) + p[0], "a Full House (" + getRankName(toak) + "s full of " + getRankName(p[0]) + "s)"};
     }
     if (f) {
-        return {static_cast<long long>(5e12) + getKickerScore(r), "a Flush (" + getRankName(r[0]) + " high)"};
+        return {R::flush + getKickerScore(r), "a Flush (" + getRankName(r[0]) + " high)"};
     }
     if (t) {
         return {static_cast<long long>(4e12) + r[0], "a Straight (" + getRankName(r[0]) + " high)"};
@@ -332,351 +1280,3206 @@ HandResult evaluate5CardHand(std::vector<Card>& h) {
     return {getKickerScore(r), "High Card " + getRankName(r[0])};
 }
 
-HandResult getFullPlayerHand(Player& p, const std::vector<Card>& simComCards) {
-    std::vector<Card> all = p.hand;
-    all.insert(all.end(), simComCards.begin(), simComCards.end());
-    
+// Best hand a player can show under the game's rules: any five of hole cards
+// plus board, or with mustUse set, exactly that many hole cards.
+template <class V>
+HandResult getBestHand(const CardList& hole, const CardList& board) {
+    using R = typename V::Ranking;
     HandResult best = {0, "Nothing"};
-    int n = all.size();
-    
-    if (n < 5) {
-        if (p.hand.empty()) return {0, "Nothing"};
-        int v1 = getCardValue(p.hand[0].rank);
-        int v2 = getCardValue(p.hand[1].rank);
-        if (v1 == v2) return {static_cast<long long>(1e12) + v1, "a Pair of " + getRankName(v1) + "s"};
-        return {std::max(v1, v2), "High Card " + getRankName(std::max(v1, v2))};
-    }
-    
-    std::vector<bool> v(n);
-    std::fill(v.begin() + (n - 5), v.end(), false);
-    std::fill(v.begin(), v.begin() + 5, true);
-    std::sort(v.rbegin(), v.rend());
-    
-    do {
-        std::vector<Card> cur5;
-        for (int i = 0; i < n; ++i) {
-            if (v[i]) {
-                cur5.push_back(all[i]);
-            }
-        }
-        HandResult curRes = evaluate5CardHand(cur5);
-        if (curRes.rank > best.rank) {
-            best = curRes;
-        }
-    } while (std::prev_permutation(v.begin(), v.end()));
-    
-    return best;
-}
-
-// ===== Monte Carlo Simulator =====
-double runMonteCarlo(Player& ai, const std::vector<Card>& mainDeck) {
-    int wins = 0;
-    int ties = 0;
-    std::vector<Card> aiHand = ai.hand;
-    
-    std::vector<Card> simDeck = getFullDeck();
-    simDeck.erase(std::remove(simDeck.begin(), simDeck.end(), aiHand[0]), simDeck.end());
-    simDeck.erase(std::remove(simDeck.begin(), simDeck.end(), aiHand[1]), simDeck.end());
-    for (const auto& card : communityCards) {
-        simDeck.erase(std::remove(simDeck.begin(), simDeck.end(), card), simDeck.end());
-    }
-    
-    for (int i = 0; i < MONTE_CARLO_SIMULATIONS; ++i) {
-        std::vector<Card> simDeckThisRound = simDeck;
-        std::shuffle(simDeckThisRound.begin(), simDeckThisRound.end(), std::mt19937(std::random_device{}()));
-        
-        Player simOpponent;
-        simOpponent.hand.push_back(simDeckThisRound.back());
-        simDeckThisRound.pop_back();
-        simOpponent.hand.push_back(simDeckThisRound.back());
-        simDeckThisRound.pop_back();
-        
-        std::vector<Card> simCommunityCards = communityCards;
-        int cardsToDeal = 5 - simCommunityCards.size();
+    if constexpr (V::mustUse > 0) {
+        if (hole.size() < (size_t)V::mustUse || board.size() < (size_t)(5 - V::mustUse)) return best;
+        std::vector<bool> h(hole.size()), b(board.size());
+        std::fill(h.begin(), h.begin() + V::mustUse, true);
+        do {
+            std::fill(b.begin(), b.end(), false);
+            std::fill(b.begin(), b.begin() + (5 - V::mustUse), true);
+            do {
+                std::vector<Card> cur5;
+                for (size_t i = 0; i < hole.size(); ++i) {
+                    if (h[i]) cur5.push_back(hole[i]);
+                }
+                for (size_t i = 0; i < board.size(); ++i) {
+                    if (b[i]) cur5.push_back(board[i]);
+                }
+                HandResult curRes = evaluate5CardHand<R>(cur5);
+                if (curRes.rank > best.rank) best = curRes;
+            } while (std::prev_permutation(b.begin(), b.end()));
+        } while (std::prev_permutation(h.begin(), h.end()));
+        return best;
+    } else {
+        std::vector<Card> all(hole.begin(), hole.end());
+        all.insert(all.end(), board.begin(), board.end());
+        int n = all.size();
         
-        for (int j = 0; j < cardsToDeal; ++j) {
-            if (simDeckThisRound.empty()) break;
-            simCommunityCards.push_back(simDeckThisRound.back());
-            simDeckThisRound.pop_back();
+        if (n < 5) {
+            if (hole.empty()) return {0, "Nothing"};
+            int v1 = getCardValue(hole[0].rank);
+            int v2 = getCardValue(hole[1].rank);
+            if (v1 == v2) return {static_cast<long long>(1e12) + v1, "a Pair of " + getRankName(v1) + "s"};
+            return {std::max(v1, v2), "High Card " + getRankName(std::max(v1, v2))};
         }
         
-        HandResult botHand = getFullPlayerHand(ai, simCommunityCards);
-        HandResult oppHand = getFullPlayerHand(simOpponent, simCommunityCards);
+        std::vector<bool> v(n);
+        std::fill(v.begin() + (n - 5), v.end(), false);
+        std::fill(v.begin(), v.begin() + 5, true);
+        std::sort(v.rbegin(), v.rend());
+        
+        do {
+            std::vector<Card> cur5;
+            for (int i = 0; i < n; ++i) {
+                if (v[i]) {
+                    cur5.push_back(all[i]);
+                }
+            }
+            HandResult curRes = evaluate5CardHand<R>(cur5);
+            if (curRes.rank > best.rank) {
+                best = curRes;
+            }
+        } while (std::prev_permutation(v.begin(), v.end()));
         
-        if (botHand.rank > oppHand.rank) wins++;
-        else if (botHand.rank == oppHand.rank) ties++;
+        return best;
     }
-    return (wins + (ties / 2.0)) / MONTE_CARLO_SIMULATIONS;
 }
 
-// ===== REVISED: AI LOGIC (Hybrid: MCS + Opponent Model + Bluffing) =====
-std::string AIAction(Player &ai, int roundNumber, const std::vector<Card>& mainDeck) {
-    int callAmt = currentBet - ai.currentBet;
-    
-    Player* opponent = getHumanOpponent();
-    double oppVPIP = 0.0, oppPFR = 0.0;
-    bool oppIsTight = false, oppIsAggressive = false;
-    
-    if (opponent && opponent->handsPlayed > 10) {
-        oppVPIP = (double)opponent->vpipActions / opponent->handsPlayed;
-        oppPFR = (double)opponent->pfrActions / opponent->handsPlayed;
-        oppIsTight = (oppVPIP < 0.20);
-        oppIsAggressive = (oppPFR > 0.15);
-    }
-    
-    double potOdds = (pot + callAmt > 0) ? (double)callAmt / (double)(pot + callAmt) : 0.0;
-    
-    // --- NEW: Thinking Animation ---
-    {
+HandResult getFullPlayerHand(Player& p, const CardList& simComCards) {
+    return getBestHand<Holdem>(p.hand, simComCards);
+}
+
+// The player's showdown hand in the table's game.
+HandResult getShowdownHand(const Table& t, const Player& p) {
+    return withVariant(t.variant, [&](auto g) { return getBestHand<decltype(g)>(p.hand, t.communityCards); });
+}
+
+// ===== Fast Hand Evaluator =====
+// Ranks hands for the Monte Carlo loop without building strings; the
+// evaluator itself lives in handeval.h, shared with the client. The result
+// equals getFullPlayerHand(...).rank, so fast and slow ranks compare
+// directly. rankHands() ranks a batch, so callers build masks for a whole
+// block of trials and the loop stays free of calls and allocation.
+// Ranks n 7-card Hold'em hand masks into out; values match getFullPlayerHand().rank.
+void rankHands(const uint64_t* hands, size_t n, long long* out) {
+    rankHandsBatch<StandardRanking>(hands, n, out);
+}
+
+long long rankHand(uint64_t hand) {
+    RankFields f;
+    rankFields<StandardRanking>(hand, f);
+    return finishRank<StandardRanking>(f);
+}
+
+// Ranks n holdings, each a hole-card mask and a five-card board mask, as the
+// game's best hand; values match getBestHand<V>().rank. Any-five games rank the
+// union. Must-use games rank every allowed split of hole and board cards (60
+// in Omaha) and keep the best; the splits come from compile-time subset
+// tables, so the loop has fixed trip counts and no data-dependent branches.
+template <class V>
+void rankHoldings(const uint64_t* holes, const uint64_t* boards, size_t n, long long* out) {
+    if constexpr (V::mustUse == 0) {
+        uint64_t hands[EVAL_BATCH];
+        for (size_t i = 0; i < n; i += EVAL_BATCH) {
+            size_t m = std::min<size_t>(EVAL_BATCH, n - i);
+            for (size_t k = 0; k < m; ++k) hands[k] = holes[i + k] | boards[i + k];
+            rankHandsBatch<typename V::Ranking>(hands, m, out + i);
+        }
+    } else {
+        static constexpr Subsets<V::holeCards, V::mustUse> hs{};
+        static constexpr Subsets<5, 5 - V::mustUse> bs{};
+        constexpr int splits = hs.count * bs.count;
+        uint64_t five[splits];
+        long long ranks[splits];
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t hc[V::holeCards], bc[5], h = holes[i], b = boards[i];
+            for (auto& c : hc) { c = h & (0 - h); h &= h - 1; } // Lowest card, then drop it
+            for (auto& c : bc) { c = b & (0 - b); b &= b - 1; }
+            uint64_t hm[hs.count] = {}, bm[bs.count] = {};
+            for (int k = 0; k < hs.count; ++k) {
+                for (int j = 0; j < V::holeCards; ++j) hm[k] |= hc[j] & (0 - (uint64_t)((hs.masks[k] >> j) & 1));
+            }
+            for (int k = 0; k < bs.count; ++k) {
+                for (int j = 0; j < 5; ++j) bm[k] |= bc[j] & (0 - (uint64_t)((bs.masks[k] >> j) & 1));
+            }
+            for (int a = 0; a < hs.count; ++a) {
+                for (int c = 0; c < bs.count; ++c) five[a * bs.count + c] = hm[a] | bm[c];
+            }
+            rankHandsBatch<typename V::Ranking>(five, splits, ranks);
+            out[i] = *std::max_element(ranks, ranks + splits);
+        }
+    }
+}
+
+// ===== Work-Stealing Scheduler =====
+// One pool runs all AI computation in the process: Monte Carlo chunks from
+// every table and, in self-play, the tables themselves. Each worker keeps
+// heaps ordered by deadline, serves its own earliest job first and otherwise
+// steals the earliest job it can find on another worker. A thread waiting on
+// a TaskGroup runs pending chunk jobs meanwhile, so nested parallelism never
+// adds threads beyond the pool.
+class TaskGroup;
+
+class WorkScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ~WorkScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(m_idleMutex);
+            m_stop = true;
+        }
+        m_idleCv.notify_all();
+        for (auto& t : m_threads) t.join();
+    }
+
+    // Starts the workers once; later calls are ignored. 0 = one per core.
+    void start(int threads) {
+        std::lock_guard<std::mutex> lock(m_startMutex);
+        if (!m_workers.empty()) return;
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        for (int i = 0; i < threads; ++i) m_workers.emplace_back(new Worker());
+        for (int i = 0; i < threads; ++i) m_threads.emplace_back(&WorkScheduler::workerLoop, this, i);
+    }
+
+    int threads() {
+        start(0);
+        return (int)m_workers.size();
+    }
+
+    // Leaf jobs are short and may be run by a thread waiting on any group;
+    // root jobs (whole tables) only run from a worker's main loop.
+    void submit(std::function<void()> fn, Clock::time_point deadline, TaskGroup* group, bool leaf = true);
+
+    // Runs one leaf job if any is queued. Used while waiting on a group.
+    bool helpOnce() {
+        Job job;
+        if (!take(true, job)) return false;
+        run(job);
+        return true;
+    }
+
+private:
+    struct Job {
+        std::function<void()> fn;
+        int64_t deadline = 0; // Clock ticks
+        uint64_t seq = 0;     // FIFO among equal deadlines
+        TaskGroup* group = nullptr;
+        bool leaf = true;
+        bool operator<(const Job& o) const { // Heap top = earliest
+            return deadline != o.deadline ? deadline > o.deadline : seq > o.seq;
+        }
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::vector<Job> leaf, root; // Heaps
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<uint64_t> m_seq{0};
+    std::atomic<int> m_queued{0};
+    bool m_stop = false;
+    std::mutex m_startMutex;
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCv;
+
+    static int& selfIndex() {
+        static thread_local int index = -1; // -1 = not a pool thread
+        return index;
+    }
+
+    static bool popEarliest(std::vector<Job>& heap, Job& out) {
+        if (heap.empty()) return false;
+        std::pop_heap(heap.begin(), heap.end());
+        out = std::move(heap.back());
+        heap.pop_back();
+        return true;
+    }
+
+    // Own heaps first, then the worker whose top job is due soonest.
+    bool take(bool leafOnly, Job& out) {
+        if (m_queued.load(std::memory_order_acquire) == 0) return false;
+        int self = selfIndex();
+        int n = (int)m_workers.size();
+        if (self >= 0) {
+            Worker& w = *m_workers[self];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (pickFrom(w, leafOnly, out)) return true;
+        }
+        int best = -1;
+        int64_t bestDeadline = 0;
+        for (int i = 0; i < n; ++i) {
+            if (i == self) continue;
+            Worker& w = *m_workers[i];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            int64_t d;
+            if (topDeadline(w, leafOnly, d) && (best < 0 || d < bestDeadline)) {
+                best = i;
+                bestDeadline = d;
+            }
+        }
+        if (best < 0) return false;
+        Worker& w = *m_workers[best];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        return pickFrom(w, leafOnly, out); // May have changed since the peek
+    }
+
+    static bool topDeadline(const Worker& w, bool leafOnly, int64_t& d) {
+        bool any = false;
+        if (!w.leaf.empty()) { d = w.leaf.front().deadline; any = true; }
+        if (!leafOnly && !w.root.empty() && (!any || w.root.front().deadline < d)) { d = w.root.front().deadline; any = true; }
+        return any;
+    }
+
+    bool pickFrom(Worker& w, bool leafOnly, Job& out) {
+        bool useRoot = !leafOnly && !w.root.empty() && (w.leaf.empty() || w.leaf.front() < w.root.front());
+        if (!popEarliest(useRoot ? w.root : w.leaf, out)) return false;
+        m_queued.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    void run(Job& job);
+
+    void workerLoop(int index) {
+        selfIndex() = index;
+        std::string name = "worker " + std::to_string(index);
+        traceThreadName(name.c_str());
+        while (true) {
+            Job job;
+            if (take(false, job)) {
+                run(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_idleMutex);
+            if (m_stop) return;
+            m_idleCv.wait(lock, [this]() { return m_stop || m_queued.load() > 0; });
+            if (m_stop) return;
+        }
+    }
+};
+
+WorkScheduler g_scheduler;
+
+// Counts a batch of submitted jobs; wait() helps run queued work until all
+// of them have finished.
+class TaskGroup {
+public:
+    void add() { m_pending.fetch_add(1, std::memory_order_relaxed); }
+
+    // Decrements under the mutex: wait() returns only after taking it, so
+    // the group is never destroyed while done() still touches it.
+    void done() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) m_cv.notify_all();
+    }
+
+    void wait() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_pending.load(std::memory_order_acquire) == 0) return;
+            }
+            if (g_scheduler.helpOnce()) continue;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait_for(lock, std::chrono::milliseconds(1),
+                          [this]() { return m_pending.load(std::memory_order_acquire) == 0; });
+        }
+    }
+
+private:
+    std::atomic<int> m_pending{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
+
+void WorkScheduler::submit(std::function<void()> fn, Clock::time_point deadline, TaskGroup* group, bool leaf) {
+    start(0);
+    if (group) group->add();
+    Job job;
+    job.fn = std::move(fn);
+    job.deadline = deadline.time_since_epoch().count();
+    job.seq = m_seq.fetch_add(1, std::memory_order_relaxed);
+    job.group = group;
+    job.leaf = leaf;
+    int self = selfIndex();
+    Worker& w = *m_workers[self >= 0 ? self : job.seq % m_workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        auto& heap = leaf ? w.leaf : w.root;
+        heap.push_back(std::move(job));
+        std::push_heap(heap.begin(), heap.end());
+    }
+    m_queued.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+    }
+    m_idleCv.notify_one();
+}
+
+void WorkScheduler::run(Job& job) {
+    job.fn();
+    if (job.group) job.group->done();
+}
+
+// ===== Monte Carlo Simulator =====
+// Equity for every live AI seat on the current board comes from one batch of
+// trials, and every seat is evaluated on the same sample points. Trials work
+// on card codes and hand masks, and EVAL_BATCH of them are ranked at once.
+//
+// Random sampling shuffles the unseen cards once per trial and deals a random
+// opponent hand and the rest of the board from the top; a seat whose own hole
+// card lands in that stretch skips it, so each seat still samples only cards it
+// cannot see. Seats that skip nothing share the opponent's evaluation.
+//
+// Stratified and quasi-random sampling, and any seat that plays against a
+// weighted opponent range, index each seat's possible opponent hands sorted by
+// class (what they make on the board; pre-flop, pairs, suited, offsuit) with a
+// running total of their range weight. A point in [0, 1) picks the hand whose
+// slice of the total contains it. A stratified batch gives each trial its own
+// equal slice of range weight and a random runout; a quasi-random batch takes
+// the opponent hand and every runout card from a randomly shifted Halton
+// sequence, which covers the space more evenly than independent draws.
+//
+// Estimates are built from independent replicates: each EVAL_BATCH of random
+// trials, or each chunk's whole point set for the other two modes. The spread
+// between replicates gives the standard error.
+struct TrialCounts {
+    int wins = 0, ties = 0;
+    int replicates = 0;
+    double sumY2 = 0, sumYN = 0, sumN2 = 0; // Per-replicate score y over n trials
+};
+
+struct EquityBatch {
+    EquitySampling sampling = EquitySampling::Random; // Other games than Hold'em sample randomly
+    GameVariant variant = GameVariant::Holdem;
+    uint64_t board = 0;           // Mask of the community cards
+    size_t boardCards = 0;
+    std::vector<uint8_t> unseen;  // Deck minus the board
+    std::vector<uint8_t> hole;    // variantHoleCards() codes per seat
+    std::vector<uint8_t> decks;   // Indexed opponents: unseen minus each seat's hole cards
+    std::vector<uint16_t> combos; // Opponent hands per seat by class, as positions in its deck
+    std::vector<float> cumWeight; // Running range weight over each seat's combos
+    std::vector<uint16_t> guide;  // Per seat: first combo past each 1/comboCount of the weight
+    size_t deckSize = 0, comboCount = 0; // Per seat; the same for every seat
+    size_t seats() const { return hole.size() / variantHoleCards(variant); }
+};
+
+struct EquityEstimate {
+    double equity = 0.0;
+    double stdError = 0.0;
+};
+
+static constexpr uint32_t HALTON_BASES[] = {2, 3, 5, 7, 11, 13}; // Opponent hand + up to 5 board cards
+
+static constexpr double radicalInverse(uint32_t i, uint32_t base) {
+    double inv = 1.0 / base, f = inv, r = 0.0;
+    for (; i; i /= base, f *= inv) r += f * (i % base);
+    return r;
+}
+
+// Halton points 1..MC_CHUNK_TRIALS; a chunk never runs more trials than that.
+// Computed at compile time, like the evaluator tables.
+struct HaltonTable {
+    double x[MC_CHUNK_TRIALS][6] = {};
+    constexpr HaltonTable() {
+        for (int i = 0; i < MC_CHUNK_TRIALS; ++i) {
+            for (int d = 0; d < 6; ++d) x[i][d] = radicalInverse(i + 1, HALTON_BASES[d]);
+        }
+    }
+};
+
+static constexpr HaltonTable g_halton;
+
+// 1326 two-card combos, c0 < c1.
+inline int comboIndex(uint8_t c0, uint8_t c1) { return c1 * (c1 - 1) / 2 + c0; }
+
+// Lists the opponent hands each seat can face, ordered by hand class: on a
+// board, by what each hand makes with it; before the flop, pairs, suited and
+// offsuit hands from the top down. Random sampling and the river skip the
+// ordering, which only the point sets need. The list is built once and
+// filtered per seat. ranges[s] weights seat s's opponent by comboIndex();
+// null = uniform.
+static void buildOpponentCombos(EquityBatch& b, const std::vector<const float*>& ranges) {
+    bool ordered = b.sampling != EquitySampling::Random && b.boardCards < 5;
+    std::vector<std::pair<long long, uint16_t>> keyed;
+    keyed.reserve(b.unseen.size() * b.unseen.size() / 2);
+    for (size_t i = 0; i < b.unseen.size(); ++i) {
+        for (size_t j = i + 1; j < b.unseen.size(); ++j) {
+            uint8_t c0 = b.unseen[i], c1 = b.unseen[j];
+            long long key = 0;
+            if (!ordered) {
+                // Generation order
+            } else if (b.boardCards >= 3) {
+                key = -rankHand(b.board | cardBit(c0) | cardBit(c1));
+            } else {
+                int hi = std::max(c0 % 13, c1 % 13), lo = std::min(c0 % 13, c1 % 13);
+                int type = hi == lo ? 0 : (c0 / 13 == c1 / 13 ? 1 : 2);
+                key = (type * 13 + (12 - hi)) * 13 + (12 - lo);
+            }
+            keyed.push_back({key * 4096 + c0 * 64 + c1, (uint16_t)(c0 << 8 | c1)});
+        }
+    }
+    if (ordered) std::sort(keyed.begin(), keyed.end());
+    b.decks.clear();
+    b.combos.clear();
+    b.cumWeight.clear();
+    b.guide.clear();
+    b.decks.reserve(b.seats() * b.unseen.size());
+    b.combos.reserve(b.seats() * keyed.size());
+    b.cumWeight.reserve(b.seats() * keyed.size());
+    for (size_t s = 0; s < b.seats(); ++s) {
+        const float* range = s < ranges.size() ? ranges[s] : nullptr;
+        float total = 0;
+        uint8_t h0 = b.hole[2 * s], h1 = b.hole[2 * s + 1];
+        uint8_t pos[52];
+        for (uint8_t c : b.unseen) {
+            if (c == h0 || c == h1) continue;
+            pos[c] = (uint8_t)(b.decks.size() - s * b.deckSize);
+            b.decks.push_back(c);
+        }
+        if (s == 0) b.deckSize = b.decks.size();
+        for (const auto& k : keyed) {
+            uint8_t c0 = k.second >> 8, c1 = k.second & 0xFF;
+            if (c0 == h0 || c0 == h1 || c1 == h0 || c1 == h1) continue;
+            b.combos.push_back((uint16_t)(pos[c0] << 8 | pos[c1]));
+            total += range ? range[comboIndex(c0, c1)] : 1.0f;
+            b.cumWeight.push_back(total);
+        }
+        if (s == 0) b.comboCount = b.combos.size();
+        const float* cum = &b.cumWeight[s * b.comboCount];
+        size_t i = 0;
+        for (size_t g = 0; g < b.comboCount; ++g) {
+            while (i + 1 < b.comboCount && cum[i] <= total * g / b.comboCount) i++;
+            b.guide.push_back((uint16_t)i);
+        }
+    }
+}
+
+// Random sampling: one shared shuffle per trial.
+template <class V>
+static size_t dealShared(const EquityBatch& b, int block, CounterRng& rng, std::vector<uint8_t>& order,
+                         uint64_t* holes, uint64_t* boards, uint16_t* botAt, uint16_t* oppAt) {
+    size_t seats = b.seats();
+    size_t toDeal = V::holeCards + (5 - b.boardCards);
+    size_t need = std::min(order.size(), toDeal + V::holeCards); // Room for a seat to skip all its cards
+    size_t n = 0;
+    for (int i = 0; i < block; ++i) {
+        for (size_t k = 0; k < need; ++k) { // Partial Fisher-Yates: only the top is dealt
+            std::swap(order[k], order[k + rng.below((uint32_t)(order.size() - k))]);
+        }
+        int sharedOpp = -1;
+        for (size_t s = 0; s < seats; ++s) {
+            uint64_t botHole = 0, oppHole = 0, runout = b.board;
+            for (int k = 0; k < V::holeCards; ++k) botHole |= cardBit(b.hole[V::holeCards * s + k]);
+            size_t dealt = 0;
+            bool skipped = false;
+            for (size_t k = 0; k < need && dealt < toDeal; ++k) {
+                if (botHole & cardBit(order[k])) {
+                    skipped = true;
+                    continue;
+                }
+                if (dealt++ < V::holeCards) oppHole |= cardBit(order[k]);
+                else runout |= cardBit(order[k]);
+            }
+            if (!skipped && sharedOpp >= 0) {
+                oppAt[i * seats + s] = (uint16_t)sharedOpp;
+            } else {
+                if (!skipped) sharedOpp = (int)n;
+                oppAt[i * seats + s] = (uint16_t)n;
+                holes[n] = oppHole;
+                boards[n++] = runout;
+            }
+            botAt[i * seats + s] = (uint16_t)n;
+            holes[n] = botHole;
+            boards[n++] = runout;
+        }
+    }
+    return n;
+}
+
+// Indexed opponents: points first..first+block of a set of `span` (random
+// sampling draws fresh points). Every seat maps the same points to its own
+// opponent hands and runout.
+static size_t dealDesigned(const EquityBatch& b, int first, int block, int span, const double* shift,
+                           CounterRng& rng, uint64_t* holes, uint64_t* boards, uint16_t* botAt, uint16_t* oppAt) {
+    size_t seats = b.seats();
+    size_t toDeal = 5 - b.boardCards;
+    size_t n = 0;
+    for (int i = 0; i < block; ++i) {
+        double x[6];
+        for (size_t d = 0; d <= toDeal; ++d) {
+            if (b.sampling == EquitySampling::QuasiRandom) {
+                x[d] = g_halton.x[first + i][d] + shift[d];
+                if (x[d] >= 1.0) x[d] -= 1.0;
+            } else if (b.sampling == EquitySampling::Stratified && d == 0) {
+                x[d] = (first + i + rng.unit()) / span;
+            } else {
+                x[d] = rng.unit();
+            }
+        }
+        for (size_t s = 0; s < seats; ++s) {
+            // The combo whose slice of the running weight holds x[0]; the
+            // guide table starts the scan within a slice or two of it.
+            const float* cum = &b.cumWeight[s * b.comboCount];
+            float target = (float)(x[0] * cum[b.comboCount - 1]);
+            size_t pick = b.guide[s * b.comboCount + (size_t)(x[0] * b.comboCount)];
+            while (pick + 1 < b.comboCount && cum[pick] <= target) pick++;
+            uint16_t combo = b.combos[s * b.comboCount + pick];
+            const uint8_t* deck = &b.decks[s * b.deckSize];
+            // Deck positions already dealt. The k-th card still in the deck is
+            // at the smallest pos with pos = k + (dealt positions <= pos).
+            uint64_t taken = (1ULL << (combo >> 8)) | (1ULL << (combo & 0xFF));
+            uint64_t runout = b.board;
+            for (size_t d = 1; d <= toDeal; ++d) {
+                size_t left = b.deckSize - 1 - d;
+                size_t k = std::min(left - 1, (size_t)(x[d] * left));
+                size_t pos = k;
+                for (;;) {
+                    size_t next = k + __builtin_popcountll(taken & ((2ULL << pos) - 1));
+                    if (next == pos) break;
+                    pos = next;
+                }
+                taken |= 1ULL << pos;
+                runout |= cardBit(deck[pos]);
+            }
+            uint8_t h0 = b.hole[2 * s], h1 = b.hole[2 * s + 1];
+            oppAt[i * seats + s] = (uint16_t)n;
+            holes[n] = cardBit(deck[combo >> 8]) | cardBit(deck[combo & 0xFF]);
+            boards[n++] = runout;
+            botAt[i * seats + s] = (uint16_t)n;
+            holes[n] = cardBit(h0) | cardBit(h1);
+            boards[n++] = runout;
+        }
+    }
+    return n;
+}
+
+template <class V>
+static void runVariantTrials(const EquityBatch& b, int trials, uint64_t key, TrialCounts* counts) {
+    CounterRng rng(key);
+    std::vector<uint8_t> order = b.unseen;
+    size_t seats = b.seats();
+    uint64_t holes[EVAL_BATCH * 2 * MAX_SEATS], boards[EVAL_BATCH * 2 * MAX_SEATS];
+    long long ranks[EVAL_BATCH * 2 * MAX_SEATS];
+    uint16_t botAt[EVAL_BATCH * MAX_SEATS], oppAt[EVAL_BATCH * MAX_SEATS];
+    bool random = b.sampling == EquitySampling::Random;
+    bool shared = b.combos.empty();
+    int replicate = random ? EVAL_BATCH : trials;
+    double shift[6] = {}; // Halton offset for this chunk's point set
+    if (!random) {
+        for (auto& d : shift) d = rng.unit();
+    }
+    double y[MAX_SEATS] = {};
+    for (int done = 0; done < trials; done += EVAL_BATCH) {
+        int block = std::min(EVAL_BATCH, trials - done);
+        size_t n;
+        if constexpr (V::holeCards == 2) {
+            n = shared ? dealShared<V>(b, block, rng, order, holes, boards, botAt, oppAt)
+                       : dealDesigned(b, done, block, trials, shift, rng, holes, boards, botAt, oppAt);
+        } else {
+            n = dealShared<V>(b, block, rng, order, holes, boards, botAt, oppAt); // Combo lists are two-card only
+        }
+        rankHoldings<V>(holes, boards, n, ranks);
+        bool closes = (done + block) % replicate == 0 || done + block == trials;
+        int size = (done % replicate) + block;
+        for (size_t s = 0; s < seats; ++s) {
+            int wins = 0, ties = 0;
+            for (int i = 0; i < block; ++i) {
+                long long bot = ranks[botAt[i * seats + s]], opp = ranks[oppAt[i * seats + s]];
+                if (bot > opp) wins++;
+                else if (bot == opp) ties++;
+            }
+            counts[s].wins += wins;
+            counts[s].ties += ties;
+            y[s] += wins + ties / 2.0;
+            if (closes) {
+                counts[s].replicates++;
+                counts[s].sumY2 += y[s] * y[s];
+                counts[s].sumYN += y[s] * size;
+                counts[s].sumN2 += (double)size * size;
+                y[s] = 0;
+            }
+        }
+    }
+}
+
+static void runTrials(const EquityBatch& b, int trials, uint64_t key, TrialCounts* counts) {
+    TraceSpan span("equity chunk", "trials", trials);
+    withVariant(b.variant, [&](auto g) { runVariantTrials<decltype(g)>(b, trials, key, counts); });
+}
+
+// Runs `trials` trials for every seat of b in MC_CHUNK_TRIALS chunks on the
+// shared scheduler, due budgetMs from now. Each chunk's stream is keyed by
+// one draw from rng and the chunk's index, so the result does not depend on
+// the thread count.
+std::vector<EquityEstimate> estimateEquity(const EquityBatch& b, int trials, CounterRng& rng, int budgetMs) {
+    size_t seats = b.seats();
+    int chunks = (trials + MC_CHUNK_TRIALS - 1) / MC_CHUNK_TRIALS;
+    std::vector<TrialCounts> counts((size_t)chunks * seats);
+    uint64_t key = rng.next64();
+    auto trialsIn = [&](int c) { return std::min(MC_CHUNK_TRIALS, trials - c * MC_CHUNK_TRIALS); };
+
+    if (chunks == 1) {
+        runTrials(b, trialsIn(0), deriveKey(key, 0), counts.data());
+    } else {
+        TaskGroup group;
+        auto deadline = WorkScheduler::Clock::now() + std::chrono::milliseconds(budgetMs);
+        for (int c = 0; c < chunks; ++c) {
+            g_scheduler.submit([&, c]() {
+                runTrials(b, trialsIn(c), deriveKey(key, c), &counts[(size_t)c * seats]);
+            }, deadline, &group);
+        }
+        group.wait();
+    }
+
+    std::vector<EquityEstimate> out(seats);
+    for (size_t s = 0; s < seats; ++s) {
+        TrialCounts sum;
+        for (int c = 0; c < chunks; ++c) {
+            const TrialCounts& part = counts[(size_t)c * seats + s];
+            sum.wins += part.wins;
+            sum.ties += part.ties;
+            sum.replicates += part.replicates;
+            sum.sumY2 += part.sumY2;
+            sum.sumYN += part.sumYN;
+            sum.sumN2 += part.sumN2;
+        }
+        double p = (sum.wins + sum.ties / 2.0) / trials;
+        out[s].equity = p;
+        if (sum.replicates > 1) {
+            // Ratio estimator over replicates: sum of (y - p*n)^2, scaled to the total.
+            double dev = sum.sumY2 - 2 * p * sum.sumYN + p * p * sum.sumN2;
+            out[s].stdError = std::sqrt(std::max(0.0, dev) * sum.replicates / (sum.replicates - 1)) / trials;
+        } else {
+            out[s].stdError = std::sqrt(p * (1 - p) / trials); // One replicate: plain sampling bound
+        }
+    }
+    return out;
+}
+
+// ===== Opponent Model & Draw Detection =====
+// Shared by AIAction() and the hand-history analyzer so both read players alike.
+struct OpponentRead {
+    double vpip = 0.0, pfr = 0.0;
+    bool tight = false, aggressive = false;
+};
+
+// Returns false until the player has enough hands for a read.
+bool readOpponent(long long handsPlayed, long long vpipActions, long long pfrActions, OpponentRead& r) {
+    if (handsPlayed <= OPP_MIN_HANDS) return false;
+    r.vpip = (double)vpipActions / handsPlayed;
+    r.pfr = (double)pfrActions / handsPlayed;
+    r.tight = (r.vpip < OPP_TIGHT_VPIP);
+    r.aggressive = (r.pfr > OPP_AGGRESSIVE_PFR);
+    return true;
+}
+
+// Pre-flop bookkeeping for one action: every voluntary call or raise counts
+// toward VPIP, only the first raise of the hand toward PFR.
+template <typename Count>
+void trackPreflopAction(bool voluntary, bool isRaise, bool& raiseMade, Count& vpipActions, Count& pfrActions) {
+    if (voluntary) vpipActions++;
+    if (isRaise && !raiseMade) {
+        pfrActions++;
+        raiseMade = true;
+    }
+}
+
+struct DrawInfo {
+    bool flushDraw = false, oesd = false, gutshot = false;
+    bool strong() const { return flushDraw || oesd; }
+};
+
+// Draws in hole cards plus board (needs at least 4 cards).
+DrawInfo detectDraws(const std::vector<Card>& curH) {
+    DrawInfo d;
+    if (curH.size() >= 4) {
+        std::map<std::string, int> sc;
+        for (const auto& c : curH) sc[c.suit]++;
+        for (auto const& [s, c] : sc) if (c == 4) d.flushDraw = true;
+        
+        std::set<int> ur;
+        for (const auto& c : curH) ur.insert(getCardValue(c.rank));
+        if (ur.count(14)) ur.insert(1); 
+        
+        for (int r : ur) {
+            if (ur.count(r + 1) && ur.count(r + 2) && ur.count(r + 3)) {
+                d.oesd = true;
+                break;
+            }
+        }
+        if (!d.oesd) {
+            for (int r : ur) {
+                if ((ur.count(r + 1) && ur.count(r + 3) && ur.count(r + 4)) || // e.g., 5,6, 8,9
+                    (r == 1 && ur.count(2) && ur.count(3) && ur.count(5)) || // A,2,3, 5
+                    (r == 11 && ur.count(12) && ur.count(13) && ur.count(14))) // J,Q,K,A
+                {
+                    d.gutshot = true;
+                    break;
+                }
+            }
+        }
+    }
+    return d;
+}
+
+// Combined read of every live opponent. Each one yields a multiplier on the
+// equity the AI needs to continue (above 1 = their bets mean strength) and a
+// fold-to-bet rate; the player who made the current bet counts double in the
+// blend. Only O(1) counters are read, once per live seat.
+struct TableRead {
+    double equityFactor = 1.0;
+    double foldAll = -1.0; // Chance everyone folds to a bet; -1 = not enough data
+    int opponents = 0;
+    int modelled = 0;
+};
+
+TableRead readTable(const Table& t, const Player& ai, int roundNumber) {
+    TableRead tr;
+    const SeatStats& st = t.seatStats;
+    int ranged = t.equityRange[&ai - t.players.data()]; // Already priced into the equity
+    double logSum = 0.0, weightSum = 0.0, foldAll = 1.0;
+    bool foldKnown = true;
+    for (size_t seat = 0; seat < t.players.size(); ++seat) {
+        const Player& p = t.players[seat];
+        if (!isModelledOpponent(t, p, ai)) continue;
+        tr.opponents++;
+
+        double f = 1.0;
+        OpponentRead r;
+        bool known = readOpponent(p.handsPlayed, p.vpipActions, p.pfrActions, r);
+        if (known && !(ranged >= 0 && (int)seat == ranged / 2)) {
+            if (r.tight && !r.aggressive) f *= 1.25;
+            else if (!r.tight && r.aggressive) f *= 0.85;
+        }
+        if (st.raises[seat] + st.calls[seat] >= OPP_MIN_SPOTS) {
+            known = true;
+            double af = (double)st.raises[seat] / std::max<uint32_t>(st.calls[seat], 1);
+            if (af > 3.0) f *= 0.95;       // Bets a lot: more bluffs in the mix
+            else if (af < 1.0) f *= 1.05;  // Mostly calls: a bet means something
+        }
+        bool bettor = (int)seat == t.lastAggressor;
+        if (bettor && roundNumber == 1 && (int)seat == t.preflopAggressor && st.cbetSpots[seat] >= OPP_MIN_SPOTS &&
+            (double)st.cbets[seat] / st.cbetSpots[seat] > 0.70) {
+            f *= 0.90; // Habitual c-bettor
+        }
+        if (bettor && roundNumber == 0 && t.preflopRaises >= 2 && st.threeBetSpots[seat] >= OPP_MIN_SPOTS &&
+            (double)st.threeBets[seat] / st.threeBetSpots[seat] < 0.05) {
+            f *= 1.20; // Rare 3-bettor
+        }
+        if (roundNumber >= 1 && st.sawFlop[seat] >= OPP_MIN_SPOTS) {
+            known = true;
+            double wtsd = (double)st.showdowns[seat] / st.sawFlop[seat];
+            if (wtsd > 0.40) f *= 0.95;      // Calling station: still in with weak hands
+            else if (wtsd < 0.20) f *= 1.10; // Gives up post-flop unless strong
+        }
+        if (known) tr.modelled++;
+
+        double w = bettor ? 2.0 : 1.0;
+        logSum += w * std::log(f);
+        weightSum += w;
+
+        if (st.facedBet[seat] >= OPP_MIN_SPOTS) foldAll *= (double)st.foldedToBet[seat] / st.facedBet[seat];
+        else foldKnown = false;
+    }
+    if (weightSum > 0) tr.equityFactor = std::exp(logSum / weightSum);
+    if (tr.opponents > 0 && foldKnown) tr.foldAll = foldAll;
+    return tr;
+}
+
+// ===== Range-Weighted Equity =====
+// A modelled opponent is not dealt uniformly random cards. Their VPIP and PFR
+// give the share of hands they play and raise, and the range takes that share
+// from the top of a pre-flop ranking (the 169 hand classes by equity against a
+// random hand), keeping a small floor weight on everything else. After a
+// pre-flop raise, the raiser holds their PFR range and anyone who called holds
+// their VPIP range with most raising hands taken out. Each AI seat plays
+// against the raiser, or after the flop against the tightest caller; with no
+// raise or no read the opponent stays uniform, as before. On the river the
+// equity against the whole range is exact: one batch ranks every opponent hand
+// and a weighted count compares them with the AI's.
+struct RangeTables {
+    float top[RANGE_STEPS + 1][1326]; // top[k]: weight 1 on the best k/RANGE_STEPS of combos
+    float strength[1326];             // Share of combos in weaker classes, ties counted half
+};
+
+static std::unique_ptr<RangeTables> buildRangeTables() {
+    std::vector<std::vector<std::pair<uint8_t, uint8_t>>> classes(169);
+    for (uint8_t c1 = 0; c1 < 52; ++c1) {
+        for (uint8_t c0 = 0; c0 < c1; ++c0) {
+            int hi = std::max(c0 % 13, c1 % 13), lo = std::min(c0 % 13, c1 % 13);
+            bool suited = c0 / 13 == c1 / 13;
+            classes[suited ? hi * 13 + lo : lo * 13 + hi].push_back({c0, c1}); // Pairs land on the diagonal
+        }
+    }
+    std::vector<std::pair<double, int>> strength;
+    for (int c = 0; c < 169; ++c) {
+        EquityBatch b;
+        for (uint8_t code = 0; code < 52; ++code) b.unseen.push_back(code);
+        b.hole = {classes[c][0].first, classes[c][0].second};
+        TrialCounts counts;
+        runTrials(b, RANGE_RANK_TRIALS, (uint32_t)c + 1, &counts);
+        strength.push_back({-(counts.wins + counts.ties / 2.0), c});
+    }
+    std::sort(strength.begin(), strength.end());
+
+    auto rt = std::make_unique<RangeTables>();
+    for (int k = 0; k <= RANGE_STEPS; ++k) {
+        double cutoff = 1326.0 * k / RANGE_STEPS, before = 0;
+        for (const auto& st : strength) {
+            const auto& combos = classes[st.second];
+            float w = (float)std::clamp((cutoff - before) / combos.size(), 0.0, 1.0);
+            for (const auto& cc : combos) rt->top[k][comboIndex(cc.first, cc.second)] = w;
+            before += combos.size();
+        }
+    }
+    double stronger = 0;
+    for (const auto& st : strength) {
+        const auto& combos = classes[st.second];
+        float share = (float)((1326.0 - stronger - combos.size() / 2.0) / 1326.0);
+        for (const auto& cc : combos) rt->strength[comboIndex(cc.first, cc.second)] = share;
+        stronger += combos.size();
+    }
+    return rt;
+}
+
+// Built on first use; ranking the classes takes a few tens of milliseconds.
+static const RangeTables& rangeTables() {
+    static const std::unique_ptr<RangeTables> tables = buildRangeTables();
+    return *tables;
+}
+
+// Fills w (by comboIndex()) with a player's range; raised = they made the
+// pre-flop raise this hand, otherwise they called one.
+void opponentRange(const OpponentRead& r, bool raised, float* w) {
+    const RangeTables& rt = rangeTables();
+    auto step = [](double f) { return std::clamp((int)std::lround(f * RANGE_STEPS), 1, RANGE_STEPS); };
+    const float* play = rt.top[step(r.vpip)];
+    const float* raise = rt.top[step(r.pfr)];
+    for (int i = 0; i < 1326; ++i) {
+        float v = raised ? raise[i] : std::max(0.0f, play[i] - (1.0f - RANGE_CALLER_RAISES) * raise[i]);
+        w[i] = RANGE_FLOOR + (1.0f - RANGE_FLOOR) * v;
+    }
+}
+
+// Which opponent range an AI seat's equity should use: -1 for a uniform
+// opponent, else seat * 2 + 1 for the pre-flop raiser or seat * 2 for a caller.
+int rangeKey(const Table& t, const Player& ai) {
+    if (t.preflopRaises == 0 || !ai.profile.ranges || t.variant != GameVariant::Holdem) return -1;
+    int caller = -1;
+    double callerVpip = 2.0;
+    for (size_t seat = 0; seat < t.players.size(); ++seat) {
+        const Player& p = t.players[seat];
+        OpponentRead r;
+        if (!isModelledOpponent(t, p, ai) || !readOpponent(p.handsPlayed, p.vpipActions, p.pfrActions, r)) continue;
+        if ((int)seat == t.preflopAggressor) return (int)seat * 2 + 1;
+        if (t.communityCards.size() >= 3 && r.vpip < callerVpip) {
+            caller = (int)seat;
+            callerVpip = r.vpip;
+        }
+    }
+    return caller >= 0 ? caller * 2 : -1;
+}
+
+// Exact equity of every seat against its weighted opponent hands on a full board.
+static std::vector<EquityEstimate> riverEquity(const EquityBatch& b) {
+    std::vector<EquityEstimate> out(b.seats());
+    std::vector<uint64_t> hands(b.comboCount);
+    std::vector<long long> ranks(b.comboCount);
+    for (size_t s = 0; s < b.seats(); ++s) {
+        const uint8_t* deck = &b.decks[s * b.deckSize];
+        const uint16_t* combos = &b.combos[s * b.comboCount];
+        const float* cum = &b.cumWeight[s * b.comboCount];
+        for (size_t i = 0; i < b.comboCount; ++i) {
+            hands[i] = b.board | cardBit(deck[combos[i] >> 8]) | cardBit(deck[combos[i] & 0xFF]);
+        }
+        rankHands(hands.data(), hands.size(), ranks.data());
+        long long hero = rankHand(b.board | cardBit(b.hole[2 * s]) | cardBit(b.hole[2 * s + 1]));
+        double score = 0;
+        for (size_t i = 0; i < b.comboCount; ++i) {
+            float w = cum[i] - (i ? cum[i - 1] : 0.0f);
+            score += w * 0.5 * ((ranks[i] < hero) + (ranks[i] <= hero));
+        }
+        out[s].equity = score / cum[b.comboCount - 1];
+    }
+    return out;
+}
+
+// Fills t.equityCache, t.equityError and t.equityRange for every AI seat still
+// in the hand. Ranges, the exact river and designed sampling are Hold'em only.
+void runEquityBatch(Table& t) {
+    bool holdem = t.variant == GameVariant::Holdem;
+    EquityBatch b;
+    b.sampling = holdem ? t.sampling : EquitySampling::Random;
+    b.variant = t.variant;
+    for (const auto& c : t.communityCards) b.board |= cardBit(cardCode(c));
+    b.boardCards = t.communityCards.size();
+    uint64_t deck = withVariant(t.variant, [](auto g) { return deckMask(decltype(g)::lowRank); });
+    for (uint8_t code = 0; code < 52; ++code) {
+        if ((deck & cardBit(code)) && !(b.board & cardBit(code))) b.unseen.push_back(code);
+    }
+    std::vector<size_t> seatIndex;
+    std::vector<std::vector<float>> weights;
+    std::vector<const float*> ranges;
+    bool ranged = false;
+    for (size_t i = 0; i < t.players.size(); ++i) {
+        Player& p = t.players[i];
+        if (p.isAI && !p.folded && !p.hand.empty()) {
+            for (const auto& c : p.hand) b.hole.push_back(cardCode(c));
+            seatIndex.push_back(i);
+            int key = rangeKey(t, p);
+            t.equityRange[i] = key;
+            weights.emplace_back();
+            if (key >= 0) {
+                const Player& opp = t.players[key / 2];
+                OpponentRead r;
+                readOpponent(opp.handsPlayed, opp.vpipActions, opp.pfrActions, r);
+                weights.back().resize(1326);
+                opponentRange(r, key & 1, weights.back().data());
+                ranged = true;
+            }
+        }
+    }
+    for (const auto& w : weights) ranges.push_back(w.empty() ? nullptr : w.data());
+    bool river = holdem && b.boardCards == 5;
+    if (ranged || river || b.sampling != EquitySampling::Random) buildOpponentCombos(b, ranges);
+
+    std::vector<EquityEstimate> est = river ? riverEquity(b) : estimateEquity(b, t.simulations, t.rng, t.decisionBudgetMs);
+    for (size_t s = 0; s < est.size(); ++s) {
+        t.equityCache[seatIndex[s]] = est[s].equity;
+        t.equityError[seatIndex[s]] = est[s].stdError;
+    }
+    t.equityBoard = (int)t.communityCards.size();
+}
+
+// Equity of one AI seat against its opponent's range, batched per street. The
+// batch is redone when the range a seat should face changes mid-street.
+double runMonteCarlo(Table& t, Player& ai) {
+    size_t seat = &ai - t.players.data();
+    if (t.equityBoard != (int)t.communityCards.size() || t.equityRange[seat] != rangeKey(t, ai)) runEquityBatch(t);
+    return t.equityCache[seat];
+}
+
+// ===== Blueprint Strategy =====
+// A strategy solved offline (`--solve`, below) for a heads-up abstraction of
+// this game: antes only, seat 0 first on every street, and the AI's own sizes
+// with at most BLUEPRINT_RAISE_CAP raises a street. Hands are bucketed by
+// strength against a random hand: the pre-flop class ranking, then equity over
+// a few hundred runouts on the flop and turn (so draws count), then the exact
+// share of hands beaten on the river. A decision point is (street, raises on
+// earlier streets, betting node, whether the player acts last, bucket) and the
+// file holds one fold/call/raise mix per point, quantized to a byte each. The
+// server maps the file read-only and an AI seat acts by sampling its mix, with
+// two light corrections for spots the abstraction does not model: each extra
+// opponent lowers the strength bucket, and a bet priced away from the
+// abstraction's size moves weight between folding and continuing.
+static const int BP_STREETS = 4;
+static const int BP_POT_CLASSES = 3; // 0, 1 or 2+ raises on earlier streets
+static const int BP_NODES = BLUEPRINT_RAISE_CAP + 2;
+static const int BP_POSITIONS = 2; // Acts first, or last, on the street
+static const int BP_ACTIONS = 3;
+static const size_t BP_POINTS = (size_t)BP_STREETS * BP_POT_CLASSES * BP_NODES * BP_POSITIONS * BLUEPRINT_BUCKETS;
+
+enum BlueprintNode { BP_OPEN = 0, BP_CHECKED_TO = 1, BP_FACING_BET = 2 }; // BP_FACING_BET + n - 1: facing n raises
+enum BlueprintAction { BP_FOLD = 0, BP_CALL = 1, BP_RAISE = 2 };
+
+static const char BLUEPRINT_MAGIC[8] = {'T', 'C', 'P', 'B', 'L', 'U', 'E', 'P'};
+static const uint32_t BLUEPRINT_VERSION = 1;
+
+struct BlueprintHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t checksum;   // hhChecksum over the strategy bytes
+    uint64_t iterations; // CFR iterations behind the strategy
+    uint16_t streets, potClasses, nodes, buckets; // Must match this build
+    uint32_t ante, stack; // Game the strategy was solved for
+    uint16_t positions;
+    uint8_t pad[22];
+};
+static_assert(sizeof(BlueprintHeader) == 64, "Blueprint header is one cache line");
+
+static uint32_t hhChecksum(const uint8_t* p, size_t n);
+
+// Chips the AI puts on top of the current bet: half the pot (at least 50)
+// when it opens, twice the call plus the pot when it raises.
+static int aiRaiseAmount(int callAmt, int pot) {
+    return callAmt == 0 ? std::max(50, pot / 2) : callAmt * 2 + pot;
+}
+
+static int blueprintNode(int callAmt, int streetRaises, int streetActions) {
+    if (callAmt == 0) return streetActions == 0 ? BP_OPEN : BP_CHECKED_TO;
+    return BP_FACING_BET + std::clamp(streetRaises, 1, BLUEPRINT_RAISE_CAP) - 1;
+}
+
+static size_t blueprintIndex(int street, int potClass, int node, int last, int bucket) {
+    return (((size_t)(street * BP_POT_CLASSES + potClass) * BP_NODES + node) * BP_POSITIONS + last) * BLUEPRINT_BUCKETS + bucket;
+}
+
+static int strengthBucket(double strength) {
+    return std::clamp((int)(strength * BLUEPRINT_BUCKETS), 0, BLUEPRINT_BUCKETS - 1);
+}
+
+// Strength of n hole pairs (two codes each) against a random hand on a board
+// of boardCards cards; see the section comment. Ties count half.
+static void handStrengths(uint64_t board, int boardCards, const uint8_t* holes, size_t n, uint64_t key, double* out) {
+    if (boardCards == 0) {
+        const RangeTables& rt = rangeTables();
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t a = holes[2 * i], b = holes[2 * i + 1];
+            out[i] = rt.strength[comboIndex(std::min(a, b), std::max(a, b))];
+        }
+        return;
+    }
+    if (boardCards < 5) {
+        EquityBatch b;
+        b.board = board;
+        b.boardCards = boardCards;
+        for (uint8_t code = 0; code < 52; ++code) {
+            if (!(board & cardBit(code))) b.unseen.push_back(code);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            b.hole.assign(holes + 2 * i, holes + 2 * i + 2);
+            TrialCounts counts;
+            runTrials(b, BLUEPRINT_EQUITY_TRIALS, deriveKey(key, i), &counts);
+            out[i] = (counts.wins + counts.ties / 2.0) / BLUEPRINT_EQUITY_TRIALS;
+        }
+        return;
+    }
+    // River: every opponent hand is ranked once and shared by all n.
+    uint64_t pairs[1326], hands[1326];
+    long long ranks[1326];
+    size_t count = 0;
+    for (uint8_t c1 = 0; c1 < 52; ++c1) {
+        if (board & cardBit(c1)) continue;
+        for (uint8_t c0 = 0; c0 < c1; ++c0) {
+            if (board & cardBit(c0)) continue;
+            pairs[count] = cardBit(c0) | cardBit(c1);
+            hands[count] = board | pairs[count];
+            count++;
+        }
+    }
+    rankHands(hands, count, ranks);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t hole = cardBit(holes[2 * i]) | cardBit(holes[2 * i + 1]);
+        long long hero = rankHand(board | hole);
+        double score = 0;
+        int seen = 0;
+        for (size_t k = 0; k < count; ++k) {
+            if (pairs[k] & hole) continue;
+            score += 0.5 * ((ranks[k] < hero) + (ranks[k] <= hero));
+            seen++;
+        }
+        out[i] = score / seen;
+    }
+}
+
+// call / (pot + call) at a facing node when the street began with 'pot' in
+// the middle and both sides sized their bets as the AI does.
+static double blueprintPrice(int pot, int node) {
+    int cur = 0, behind = 0; // Current bet, and what the player facing it has in
+    for (int r = BP_FACING_BET; r <= node; ++r) {
+        int total = cur + aiRaiseAmount(cur - behind, pot);
+        pot += total - behind;
+        behind = cur;
+        cur = total;
+    }
+    return (double)(cur - behind) / (pot + cur - behind);
+}
+
+class BlueprintTable {
+public:
+    ~BlueprintTable() {
+#ifndef _WIN32
+        if (m_map) munmap(m_map, m_mapSize);
+#endif
+    }
+
+    bool open(const std::string& path, std::string& error) {
+        size_t size = sizeof(BlueprintHeader) + BP_POINTS * BP_ACTIONS;
+#ifdef _WIN32
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) {
+            error = "cannot open";
+            return false;
+        }
+        m_copy.resize(size + 1);
+        size_t got = std::fread(m_copy.data(), 1, m_copy.size(), f);
+        std::fclose(f);
+        if (got != size) {
+            error = "wrong size";
+            return false;
+        }
+        const uint8_t* data = m_copy.data();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+            ::close(fd);
+            error = "wrong size";
+            return false;
+        }
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            error = "cannot map";
+            return false;
+        }
+        m_map = p;
+        m_mapSize = size;
+        const uint8_t* data = static_cast<const uint8_t*>(p);
+#endif
+        const BlueprintHeader* h = reinterpret_cast<const BlueprintHeader*>(data);
+        const uint8_t* strategy = data + sizeof(BlueprintHeader);
+        if (std::memcmp(h->magic, BLUEPRINT_MAGIC, 8) != 0 || h->version != BLUEPRINT_VERSION) {
+            error = "not a blueprint file";
+            return false;
+        }
+        if (h->streets != BP_STREETS || h->potClasses != BP_POT_CLASSES || h->nodes != BP_NODES ||
+            h->positions != BP_POSITIONS || h->buckets != BLUEPRINT_BUCKETS) {
+            error = "solved for a different abstraction";
+            return false;
+        }
+        if (hhChecksum(strategy, BP_POINTS * BP_ACTIONS) != h->checksum) {
+            error = "checksum mismatch";
+            return false;
+        }
+        m_header = *h;
+        m_strategy = strategy;
+        return true;
+    }
+
+    bool loaded() const { return m_strategy != nullptr; }
+    const BlueprintHeader& header() const { return m_header; }
+
+    // Fold/call/raise weights summing to 255, or null where the solve never got.
+    const uint8_t* mix(size_t point) const {
+        const uint8_t* m = m_strategy + point * BP_ACTIONS;
+        return (m[0] | m[1] | m[2]) ? m : nullptr;
+    }
+
+private:
+    BlueprintHeader m_header{};
+    const uint8_t* m_strategy = nullptr;
+#ifdef _WIN32
+    std::vector<uint8_t> m_copy;
+#else
+    void* m_map = nullptr;
+    size_t m_mapSize = 0;
+#endif
+};
+
+BlueprintTable g_blueprint; // Loaded once at startup, read-only after
+
+// A strategy solved for other antes or stacks prices every bet wrong, so it
+// is refused rather than played.
+bool loadBlueprint(const std::string& path, int ante, int stack) {
+    std::string error;
+    if (!g_blueprint.open(path, error)) {
+        std::cerr << "Cannot load blueprint " << path << ": " << error << std::endl;
+        return false;
+    }
+    const BlueprintHeader& h = g_blueprint.header();
+    if (h.ante != (uint32_t)ante || h.stack != (uint32_t)stack) {
+        std::cerr << "Cannot load blueprint " << path << ": solved for ante " << h.ante << " and " << h.stack
+                  << " chips, this table plays ante " << ante << " and " << stack << " chips (re-solve with --ante "
+                  << ante << " --chips " << stack << ")" << std::endl;
+        return false;
+    }
+    std::cout << "Blueprint " << path << ": " << h.iterations << " iterations, solved for ante " << h.ante
+              << " and " << h.stack << " chips" << std::endl;
+    return true;
+}
+
+// The blueprint's action for an AI seat, or "" to leave it to AIAction()'s rules.
+std::string blueprintAction(Table& t, Player& ai, int roundNumber) {
+    int callAmt = t.currentBet - ai.currentBet;
+    uint8_t hole[2] = {cardCode(ai.hand[0]), cardCode(ai.hand[1])};
+    uint64_t board = 0;
+    for (const auto& c : t.communityCards) board |= cardBit(cardCode(c));
+    int opponents = 0, streetPot = t.pot, last = 1;
+    for (const auto& p : t.players) {
+        streetPot -= p.currentBet;
+        if (&p == &ai || p.folded || !p.isConnected) continue;
+        opponents++;
+        if (&p > &ai && !p.allIn) last = 0; // Seat order is action order on every street
+    }
+    double strength;
+    handStrengths(board, (int)t.communityCards.size(), hole, 1, t.rng.next64(), &strength);
+    strength = std::pow(strength, std::max(opponents, 1)); // Has to beat each of them
+
+    int node = blueprintNode(callAmt, t.streetRaises, t.streetActions);
+    int potClass = std::min(t.handRaises, BP_POT_CLASSES - 1);
+    const uint8_t* m = g_blueprint.mix(blueprintIndex(roundNumber, potClass, node, last, strengthBucket(strength)));
+    if (!m) return "";
+
+    double w[BP_ACTIONS] = {(double)m[BP_FOLD], (double)m[BP_CALL], (double)m[BP_RAISE]};
+    if (callAmt > 0) {
+        // A bet dearer than the abstraction's sheds continues; a cheaper one sheds folds.
+        double scale = blueprintPrice(streetPot, node) / ((double)callAmt / (t.pot + callAmt));
+        if (scale < 1.0) {
+            w[BP_CALL] *= scale;
+            w[BP_RAISE] *= scale;
+        } else {
+            w[BP_FOLD] /= scale;
+        }
+    } else {
+        w[BP_FOLD] = 0;
+    }
+    int rAmt = std::min(aiRaiseAmount(callAmt, t.pot), ai.chips);
+    if (rAmt <= callAmt) {
+        w[BP_CALL] += w[BP_RAISE];
+        w[BP_RAISE] = 0;
+    }
+    double pick = t.rng.unit() * (w[0] + w[1] + w[2]);
+    int action = pick < w[BP_FOLD] ? BP_FOLD : pick < w[BP_FOLD] + w[BP_CALL] ? BP_CALL : BP_RAISE;
+
+    AIStats& stats = t.aiStats;
+    stats.blueprint++;
+    if (callAmt > 0) stats.facingBet++;
+    if (!t.headless) {
+        std::lock_guard<std::mutex> lock(g_io_mutex);
+        std::cout << "AI Debug: Blueprint S=" << (strength * 100) << "% node " << node << " mix "
+                  << (int)m[BP_FOLD] << "/" << (int)m[BP_CALL] << "/" << (int)m[BP_RAISE] << std::endl;
+    }
+    if (action == BP_RAISE) return "RAISE " + std::to_string(rAmt);
+    if (callAmt == 0) return "CHECK";
+    if (action == BP_FOLD) {
+        stats.folds++;
+        return "FOLD";
+    }
+    return "CALL";
+}
+
+// ===== REVISED: AI LOGIC (Hybrid: MCS + Opponent Model + Bluffing) =====
+static void showThinking(const Table& t, const Player& ai) {
+    if (t.headless || !t.thinkDelay) return;
+    std::lock_guard<std::mutex> lock(g_io_mutex);
+    std::cout << ai.name << " is thinking    " << std::flush;
+    for (int i = 0; i < 3; ++i) { // Adjust loop count for desired duration
+        std::cout << "\b\b\b.  " << std::flush;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::cout << "\b\b\b.. " << std::flush;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::cout << "\b\b\b..." << std::flush;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    std::cout << "\r" << std::string(30, ' ') << "\r";
+}
+
+std::string AIAction(Table& t, Player &ai, int roundNumber) {
+    int callAmt = t.currentBet - ai.currentBet;
+    int pot = t.pot;
+    AIStats& stats = t.aiStats;
+    stats.decisions++;
+    
+    if (ai.profile.blueprint && g_blueprint.loaded() && t.variant == GameVariant::Holdem) {
+        std::string action = blueprintAction(t, ai, roundNumber);
+        if (!action.empty()) {
+            showThinking(t, ai);
+            return action;
+        }
+    }
+    
+    double equity = runMonteCarlo(t, ai); // Before the read: it skips a range already priced in
+    TableRead read = readTable(t, ai, roundNumber);
+    
+    double potOdds = (pot + callAmt > 0) ? (double)callAmt / (double)(pot + callAmt) : 0.0;
+    
+    showThinking(t, ai);
+    
+    std::vector<Card> curH(ai.hand.begin(), ai.hand.end());
+    curH.insert(curH.end(), t.communityCards.begin(), t.communityCards.end());
+    DrawInfo draws = t.variant == GameVariant::Omaha ? DrawInfo() : detectDraws(curH); // Assumes any five cards play
+    bool hasGutshot = draws.gutshot;
+    bool strongDraw = draws.strong();
+    
+    const AIProfile& style = ai.profile;
+    double requiredEquity = potOdds;
+    if (callAmt > 0) {
+        requiredEquity *= read.equityFactor * style.tightness;
+    }
+    
+    if (strongDraw && callAmt > 0 && callAmt < pot / 2.0) requiredEquity *= 0.75;
+    else if (hasGutshot && callAmt > 0 && callAmt < pot / 3.0) requiredEquity *= 0.90;
+    
+    if (!t.headless) {
         std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cout << "AI_Bot is thinking    " << std::flush;
-        for (int i = 0; i < 3; ++i) { // Adjust loop count for desired duration
-            std::cout << "\b\b\b.  " << std::flush;
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            std::cout << "\b\b\b.. " << std::flush;
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            std::cout << "\b\b\b..." << std::flush;
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::cout << "AI Debug: E=" << (equity * 100) << "% (+/-" << (t.equityError[&ai - t.players.data()] * 100)
+                  << ")|Need=" << (potOdds * 100) << "%|AdjNeed=" << (requiredEquity * 100) << "%" << std::endl;
+        int ranged = t.equityRange[&ai - t.players.data()];
+        if (ranged >= 0) {
+            const Player& opp = t.players[ranged / 2];
+            std::cout << "AI Debug: Range of " << opp.name << " (" << ((ranged & 1) ? "raised" : "called")
+                      << ", VPIP " << (100.0 * opp.vpipActions / opp.handsPlayed) << "%, PFR "
+                      << (100.0 * opp.pfrActions / opp.handsPlayed) << "%)" << std::endl;
+        }
+        if (read.modelled > 0) {
+            std::cout << "AI Debug: Read x" << read.equityFactor << " over " << read.opponents << " opp(s), "
+                      << read.modelled << " modelled";
+            if (read.foldAll >= 0) std::cout << ", all fold " << (read.foldAll * 100) << "%";
+            std::cout << std::endl;
+        }
+        if (strongDraw) std::cout << "AI Debug: Strong Draw." << std::endl;
+        else if (hasGutshot) std::cout << "AI Debug: Gutshot." << std::endl;
+    }
+    
+    auto roll = [&]() { return (int)t.rng.below(100) + 1; }; // 1..100
+    
+    if (callAmt == 0) {
+        // --- Bluffing Logic (profile rate, 10% by default, on turn/river if checked to) ---
+        if ((roundNumber == 2 || roundNumber == 3) && read.opponents > 0) {
+            stats.bluffSpots++;
+            // The profile's rate when half the time everyone folds; scaled by the observed fold rate.
+            int bluffPct = style.bluffPct;
+            if (read.foldAll >= 0) {
+                bluffPct = std::max(style.bluffPct / 5, std::min(2 * style.bluffPct, (int)(2 * style.bluffPct * read.foldAll + 0.5)));
+            }
+            if (roll() <= bluffPct) {
+                int bAmt = aiRaiseAmount(0, pot);
+                if (bAmt > ai.chips) bAmt = ai.chips;
+                if (bAmt <= 0) return "CHECK";
+                stats.bluffs++;
+                logLine(t, "AI Debug: Bluff bet.");
+                return "RAISE " + std::to_string(bAmt);
+            }
+        }
+        
+        // --- Value Betting ---
+        if (equity > style.valueBet || strongDraw) {
+            int bAmt = aiRaiseAmount(0, pot);
+            if (bAmt > ai.chips) bAmt = ai.chips;
+            if (bAmt <= 0) return "CHECK";
+            stats.valueBets++;
+            return "RAISE " + std::to_string(bAmt);
+        } else {
+            return "CHECK";
+        }
+    } else {
+        stats.facingBet++;
+        if (equity > requiredEquity) {
+            // --- Semi-bluff Raise (profile rate, 20% by default, with strong draw) ---
+            if (strongDraw) {
+                stats.semiBluffSpots++;
+                if (roll() <= style.semiBluffPct) {
+                    int rAmt = aiRaiseAmount(callAmt, pot);
+                    if (rAmt > ai.chips) rAmt = ai.chips;
+                    if (rAmt <= callAmt) return "CALL";
+                    stats.semiBluffs++;
+                    logLine(t, "AI Debug: Semi-bluff raise.");
+                    return "RAISE " + std::to_string(rAmt);
+                }
+            }
+            
+            // --- Value Raise ---
+            if (equity > style.valueRaise && !strongDraw) {
+                int rAmt = aiRaiseAmount(callAmt, pot);
+                if (rAmt > ai.chips) rAmt = ai.chips;
+                if (rAmt <= callAmt) return "CALL";
+                stats.valueRaises++;
+                return "RAISE " + std::to_string(rAmt);
+            }
+            return "CALL";
+        } else {
+            stats.folds++;
+            if (!t.headless) {
+                std::lock_guard<std::mutex> lock(g_io_mutex);
+                std::cout << "AI Debug: Folding. E " << (equity * 100) << "% < Req " << (requiredEquity * 100) << "%." << std::endl;
+            }
+            return "FOLD";
+        }
+    }
+}
+
+
+// ===== Hand History =====
+// Append-only binary log. The file starts with an 8-byte magic and a u32
+// version; after that come records of [u8 type][u32 length][u32 checksum]
+// [payload], little-endian. Every HH_INDEX_INTERVAL hands the writer appends
+// an index block holding the offset of each of those hands and of the previous
+// index block, ending in a trailer that lets readers find the newest block by
+// searching back from the end of the file. A torn record at the tail (crash mid-write) fails its checksum
+// and is truncated away the next time the file is opened for appending.
+static const char HH_MAGIC[8] = {'T', 'C', 'P', 'H', 'H', 'I', 'S', 'T'};
+static const uint32_t HH_VERSION = 1;
+static const size_t HH_FILE_HEADER = 12;
+static const size_t HH_RECORD_HEADER = 9;
+static const char HH_INDEX_MAGIC[8] = {'H', 'H', 'I', 'N', 'D', 'E', 'X', '!'};
+static const size_t HH_INDEX_TRAILER = 16;
+enum HandHistoryRecordType : uint8_t { HH_REC_HAND = 1, HH_REC_INDEX = 2 };
+
+static uint32_t hhChecksum(const uint8_t* p, size_t n) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct ByteWriter {
+    std::vector<uint8_t>& out;
+    void u8(uint8_t v) { out.push_back(v); }
+    void u16(uint16_t v) { for (int i = 0; i < 2; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+    void i32(int v) { u32(static_cast<uint32_t>(v)); }
+    void str(const std::string& s) {
+        size_t n = std::min<size_t>(s.size(), 255);
+        u8(static_cast<uint8_t>(n));
+        out.insert(out.end(), s.begin(), s.begin() + n);
+    }
+    void patch32(size_t at, uint32_t v) { for (int i = 0; i < 4; ++i) out[at + i] = static_cast<uint8_t>(v >> (8 * i)); }
+};
+
+struct ByteReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+    bool need(size_t n) { if ((size_t)(end - p) < n) ok = false; return ok; }
+    uint8_t u8() { if (!need(1)) return 0; return *p++; }
+    uint16_t u16() { if (!need(2)) return 0; uint16_t v = p[0] | (p[1] << 8); p += 2; return v; }
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(p[i]) << (8 * i);
+        p += 4;
+        return v;
+    }
+    uint64_t u64() { uint64_t lo = u32(); uint64_t hi = u32(); return lo | (hi << 32); }
+    int i32() { return static_cast<int>(u32()); }
+    void str(std::string& s) {
+        uint8_t n = u8();
+        if (!need(n)) return;
+        s.assign(reinterpret_cast<const char*>(p), n);
+        p += n;
+    }
+};
+
+// One decoded hand. Buffers are reused between next() calls.
+struct HandRecord {
+    uint64_t handId = 0;
+    HandLog log;
+};
+
+// Appends a finished hand as one record. The caller fills in the checksum.
+static void encodeHand(std::vector<uint8_t>& out, uint64_t handId, const HandLog& log) {
+    ByteWriter w{out};
+    w.u8(HH_REC_HAND);
+    size_t lenAt = out.size();
+    w.u32(0);
+    w.u32(0);
+    size_t payloadAt = out.size();
+    w.u64(handId);
+    w.u64(log.startMs);
+    w.u8(static_cast<uint8_t>(log.seats.size()));
+    for (const auto& s : log.seats) {
+        w.str(s.name);
+        w.i32(s.startStack);
+        w.i32(s.ante);
+        w.i32(s.won);
+        bool four = s.hole[2] != 0xFF;
+        w.u8(static_cast<uint8_t>((s.isAI ? 1 : 0) | (s.showdown ? 2 : 0) | (four ? 4 : 0)));
+        for (int k = 0; k < (four ? 4 : 2); ++k) w.u8(s.hole[k]);
+    }
+    w.u8(static_cast<uint8_t>(log.board.size()));
+    for (uint8_t c : log.board) w.u8(c);
+    w.u16(static_cast<uint16_t>(log.actions.size()));
+    for (const auto& a : log.actions) {
+        w.u8(a.street);
+        w.u8(a.seat);
+        w.u8(static_cast<uint8_t>(a.type | (a.allIn ? 0x80 : 0)));
+        w.i32(a.amount);
+    }
+    w.patch32(lenAt, static_cast<uint32_t>(out.size() - payloadAt));
+    w.patch32(lenAt + 4, hhChecksum(out.data() + payloadAt, out.size() - payloadAt));
+}
+
+static bool decodeHand(const uint8_t* payload, size_t len, HandRecord& rec) {
+    ByteReader r{payload, payload + len};
+    HandLog& log = rec.log;
+    rec.handId = r.u64();
+    log.startMs = r.u64();
+    log.seats.resize(r.u8());
+    for (auto& s : log.seats) {
+        r.str(s.name);
+        s.startStack = r.i32();
+        s.ante = r.i32();
+        s.won = r.i32();
+        uint8_t flags = r.u8();
+        s.isAI = flags & 1;
+        s.showdown = flags & 2;
+        for (int k = 0; k < 4; ++k) s.hole[k] = (k < 2 || (flags & 4)) ? r.u8() : 0xFF;
+    }
+    log.board.resize(r.u8());
+    for (auto& c : log.board) c = r.u8();
+    log.actions.resize(r.u16());
+    for (auto& a : log.actions) {
+        a.street = r.u8();
+        a.seat = r.u8();
+        uint8_t type = r.u8();
+        a.type = type & 0x7F;
+        a.allIn = type & 0x80;
+        a.amount = r.i32();
+    }
+    return r.ok;
+}
+
+// Memory-maps a hand-history file and walks its records in place.
+class HandHistoryReader {
+public:
+    ~HandHistoryReader() { close(); }
+
+    bool open(const std::string& path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)HH_FILE_HEADER) { ::close(fd); return false; }
+        m_size = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        m_data = static_cast<const uint8_t*>(p);
+        madvise(p, m_size, MADV_SEQUENTIAL);
+#else
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return false;
+        std::fseek(f, 0, SEEK_END);
+        m_copy.resize(static_cast<size_t>(std::ftell(f)));
+        std::fseek(f, 0, SEEK_SET);
+        size_t got = std::fread(m_copy.data(), 1, m_copy.size(), f);
+        std::fclose(f);
+        if (got != m_copy.size() || got < HH_FILE_HEADER) return false;
+        m_data = m_copy.data();
+        m_size = m_copy.size();
+#endif
+        if (std::memcmp(m_data, HH_MAGIC, 8) != 0) { close(); return false; }
+        m_pos = HH_FILE_HEADER;
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    // Decodes the next hand at or after the cursor; false at end of file.
+    bool next(HandRecord& rec) { return nextAt(m_pos, m_size, rec); }
+
+    // Decodes the next hand starting at byte offset 'pos' and before 'limit',
+    // advancing 'pos'. Const, so any number of threads can walk one mapping.
+    bool nextAt(size_t& pos, size_t limit, HandRecord& rec) const {
+        pos = std::max(pos, HH_FILE_HEADER);
+        limit = std::min(limit, m_size);
+        while (pos + HH_RECORD_HEADER <= limit) {
+            ByteReader r{m_data + pos, m_data + m_size};
+            uint8_t type = r.u8();
+            uint32_t len = r.u32();
+            r.u32(); // Checksum: only checked by the writer's recovery pass
+            size_t payload = pos + HH_RECORD_HEADER;
+            if (payload + len > m_size) return false;
+            pos = payload + len;
+            if (type == HH_REC_HAND && decodeHand(m_data + payload, len, rec)) return true;
+        }
+        return false;
+    }
+
+    // Offset of the newest intact index block, or 0. Found by searching back
+    // from the end for the trailer, so the bulk of the file is never touched.
+    size_t newestIndexBlock() const {
+        if (m_size < HH_FILE_HEADER + HH_RECORD_HEADER + HH_INDEX_TRAILER) return 0;
+        for (size_t end = m_size; end >= HH_FILE_HEADER + HH_RECORD_HEADER + HH_INDEX_TRAILER; --end) {
+            const uint8_t* magic = m_data + end - 8;
+            if (std::memcmp(magic, HH_INDEX_MAGIC, 8) != 0) continue;
+            ByteReader r{magic - 8, magic};
+            uint64_t at = r.u64();
+            if (isIndexBlock(at, end)) return static_cast<size_t>(at);
+        }
+        return 0;
+    }
+
+    // Splits the file into runs of hands, one per index block plus the
+    // unindexed tail, so callers can process it piecewise. Walks the index
+    // chain backwards; only the tail past the newest block is scanned.
+    struct Chunk {
+        size_t begin, end;
+        size_t hands;
+    };
+    std::vector<Chunk> chunks() const {
+        std::vector<Chunk> out;
+        size_t newest = newestIndexBlock();
+        size_t tailStart = HH_FILE_HEADER;
+        if (newest != 0) {
+            tailStart = recordEnd(newest);
+            for (size_t at = newest; at != 0;) {
+                ByteReader r{m_data + at + HH_RECORD_HEADER, m_data + m_size};
+                size_t prev = static_cast<size_t>(r.u64());
+                uint32_t count = r.u32();
+                size_t first = count > 0 ? static_cast<size_t>(r.u64()) : at;
+                if (!r.ok) break;
+                out.push_back({first, at, count});
+                at = prev;
+            }
+            std::reverse(out.begin(), out.end());
+        }
+        size_t tailHands = 0;
+        size_t off = tailStart;
+        while (off + HH_RECORD_HEADER <= m_size) {
+            size_t next = recordEnd(off);
+            if (next == 0) break;
+            if (m_data[off] == HH_REC_HAND) tailHands++;
+            off = next;
+        }
+        if (tailHands > 0) out.push_back({tailStart, off, tailHands});
+        return out;
+    }
+
+    // Where a crashed writer left off: walks the records after the newest
+    // index block, checking checksums, and stops at the first bad one.
+    struct Tail {
+        size_t validEnd = HH_FILE_HEADER;
+        size_t lastIndex = 0;
+        uint64_t lastHandId = 0;
+        std::vector<uint64_t> unindexed; // Hands after the newest index block
+    };
+    Tail scanTail() const {
+        Tail tail;
+        tail.lastIndex = newestIndexBlock();
+        size_t off = HH_FILE_HEADER;
+        if (tail.lastIndex != 0) {
+            off = recordEnd(tail.lastIndex);
+            ByteReader r{m_data + tail.lastIndex + HH_RECORD_HEADER, m_data + m_size};
+            r.u64();
+            uint32_t count = r.u32();
+            for (uint32_t i = 0; i + 1 < count; ++i) r.u64();
+            if (count > 0) {
+                ByteReader hr{m_data + r.u64() + HH_RECORD_HEADER, m_data + m_size};
+                tail.lastHandId = hr.u64();
+            }
+        }
+        while (off + HH_RECORD_HEADER <= m_size) {
+            ByteReader r{m_data + off, m_data + m_size};
+            uint8_t type = r.u8();
+            uint32_t len = r.u32();
+            uint32_t sum = r.u32();
+            size_t payload = off + HH_RECORD_HEADER;
+            if (payload + len > m_size || hhChecksum(m_data + payload, len) != sum) break;
+            if (type == HH_REC_HAND) {
+                ByteReader hr{m_data + payload, m_data + payload + len};
+                tail.lastHandId = hr.u64();
+                tail.unindexed.push_back(off);
+            } else if (type == HH_REC_INDEX) {
+                tail.lastIndex = off;
+                tail.unindexed.clear();
+            }
+            off = payload + len;
+        }
+        tail.validEnd = off;
+        return tail;
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    // End offset of the record at 'off', or 0 if it runs past the file.
+    size_t recordEnd(size_t off) const {
+        if (off + HH_RECORD_HEADER > m_size) return 0;
+        ByteReader r{m_data + off + 1, m_data + m_size};
+        size_t end = off + HH_RECORD_HEADER + r.u32();
+        return end <= m_size ? end : 0;
+    }
+
+    bool isIndexBlock(uint64_t at, size_t end) const {
+        if (at < HH_FILE_HEADER || at + HH_RECORD_HEADER > end) return false;
+        ByteReader r{m_data + at, m_data + end};
+        if (r.u8() != HH_REC_INDEX) return false;
+        uint32_t len = r.u32();
+        uint32_t sum = r.u32();
+        return at + HH_RECORD_HEADER + len == end &&
+               hhChecksum(m_data + at + HH_RECORD_HEADER, len) == sum;
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_pos = HH_FILE_HEADER;
+#ifdef _WIN32
+    std::vector<uint8_t> m_copy;
+#endif
+};
+
+// Background writer. Game threads encode a hand and append it to a staging
+// buffer under a short lock; a dedicated thread swaps the buffer out, writes it
+// with one call and adds index blocks, so disk latency never reaches a table.
+class HandHistoryWriter {
+public:
+    ~HandHistoryWriter() { close(); }
+
+    bool open(const std::string& path) {
+        if (!recover(path)) return false;
+        m_file = std::fopen(path.c_str(), "r+b");
+        if (!m_file) return false;
+        std::fseek(m_file, static_cast<long>(m_offset), SEEK_SET);
+        m_stop = false;
+        m_thread = std::thread(&HandHistoryWriter::run, this);
+        return true;
+    }
+
+    void submit(const HandLog& log) {
+        thread_local std::vector<uint8_t> scratch;
+        scratch.clear();
+        encodeHand(scratch, m_nextHandId.fetch_add(1), log);
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            wake = m_front.empty();
+            m_front.insert(m_front.end(), scratch.begin(), scratch.end());
+        }
+        if (wake) m_cv.notify_one();
+    }
+
+    void close() {
+        if (!m_file) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable()) m_thread.join();
+        if (!m_index.empty()) writeIndexBlock();
+        std::fflush(m_file);
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+private:
+    // Creates the file or picks up an existing one where it left off,
+    // truncating a torn record at the tail.
+    bool recover(const std::string& path) {
+        HandHistoryReader reader;
+        if (!reader.open(path)) {
+            std::FILE* f = std::fopen(path.c_str(), "rb");
+            if (f) {
+                std::fseek(f, 0, SEEK_END);
+                long size = std::ftell(f);
+                std::fclose(f);
+                if (size >= (long)HH_FILE_HEADER) return false; // Not a hand-history file
+            }
+            f = std::fopen(path.c_str(), "wb");
+            if (!f) return false;
+            std::vector<uint8_t> hdr(HH_MAGIC, HH_MAGIC + 8);
+            ByteWriter{hdr}.u32(HH_VERSION);
+            std::fwrite(hdr.data(), 1, hdr.size(), f);
+            std::fclose(f);
+            m_offset = HH_FILE_HEADER;
+            return true;
+        }
+        HandHistoryReader::Tail tail = reader.scanTail();
+        size_t size = reader.size();
+        reader.close();
+        m_offset = tail.validEnd;
+        m_lastIndex = tail.lastIndex;
+        m_index = tail.unindexed;
+        m_nextHandId = tail.lastHandId + 1;
+        if (tail.validEnd != size) {
+#ifdef _WIN32
+            std::FILE* f = std::fopen(path.c_str(), "r+b");
+            if (!f) return false;
+            _chsize_s(_fileno(f), static_cast<long long>(tail.validEnd));
+            std::fclose(f);
+#else
+            if (truncate(path.c_str(), static_cast<off_t>(tail.validEnd)) != 0) return false;
+#endif
+        }
+        return true;
+    }
+
+    void run() {
+        std::vector<uint8_t> batch;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_cv.wait(lock, [this] { return m_stop || !m_front.empty(); });
+            if (m_front.empty() && m_stop) break;
+            batch.swap(m_front);
+            lock.unlock();
+
+            // Note where each hand lands so the next index block can point at it.
+            size_t off = 0;
+            while (off + HH_RECORD_HEADER <= batch.size()) {
+                ByteReader r{batch.data() + off + 1, batch.data() + batch.size()};
+                uint32_t len = r.u32();
+                m_index.push_back(m_offset + off);
+                off += HH_RECORD_HEADER + len;
+            }
+            std::fwrite(batch.data(), 1, batch.size(), m_file);
+            m_offset += batch.size();
+            batch.clear();
+            if (m_index.size() >= HH_INDEX_INTERVAL) writeIndexBlock();
+            std::fflush(m_file);
+
+            lock.lock();
+        }
+    }
+
+    // Payload: u64 previous index block offset (0 = none), u32 count, u64
+    // offsets, then a trailer of this block's own offset and HH_INDEX_MAGIC so
+    // readers can find the newest block from the end of the file.
+    void writeIndexBlock() {
+        std::vector<uint8_t> rec;
+        ByteWriter w{rec};
+        w.u8(HH_REC_INDEX);
+        w.u32(0);
+        w.u32(0);
+        w.u64(m_lastIndex);
+        w.u32(static_cast<uint32_t>(m_index.size()));
+        for (uint64_t o : m_index) w.u64(o);
+        w.u64(m_offset);
+        rec.insert(rec.end(), HH_INDEX_MAGIC, HH_INDEX_MAGIC + 8);
+        size_t len = rec.size() - HH_RECORD_HEADER;
+        w.patch32(1, static_cast<uint32_t>(len));
+        w.patch32(5, hhChecksum(rec.data() + HH_RECORD_HEADER, len));
+        std::fwrite(rec.data(), 1, rec.size(), m_file);
+        m_lastIndex = m_offset;
+        m_offset += rec.size();
+        m_index.clear();
+    }
+
+    std::FILE* m_file = nullptr;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<uint8_t> m_front;
+    bool m_stop = false;
+    std::atomic<uint64_t> m_nextHandId{1};
+    // Writer-thread state
+    uint64_t m_offset = 0;
+    uint64_t m_lastIndex = 0;
+    std::vector<uint64_t> m_index;
+};
+
+static const char* handActionName(uint8_t type) {
+    switch (type) {
+        case HA_FOLD: return "folds";
+        case HA_CHECK: return "checks";
+        case HA_CALL: return "calls";
+        case HA_RAISE: return "raises";
+    }
+    return "?";
+}
+
+// Prints every hand in a history file as text.
+int replayHandHistory(const std::string& path) {
+    HandHistoryReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Cannot open hand history " << path << std::endl;
+        return 1;
+    }
+    static const char* streets[] = {"Pre-flop", "Flop", "Turn", "River"};
+    HandRecord rec;
+    while (reader.next(rec)) {
+        const HandLog& log = rec.log;
+        std::cout << "Hand #" << rec.handId << "\n";
+        for (const auto& s : log.seats) {
+            std::cout << "  " << s.name << (s.isAI ? " (AI)" : "") << " stack " << s.startStack
+                      << ", ante " << s.ante << ", hole " << cardFromCode(s.hole[0]).toString();
+            for (int k = 1; k < 4 && s.hole[k] != 0xFF; ++k) std::cout << " " << cardFromCode(s.hole[k]).toString();
+            std::cout << "\n";
+        }
+        int street = -1;
+        for (const auto& a : log.actions) {
+            if (a.street != street) {
+                street = a.street;
+                std::cout << "  " << streets[street & 3] << ":";
+                size_t shown = street == 0 ? 0 : std::min<size_t>(log.board.size(), street + 2);
+                for (size_t i = 0; i < shown; ++i) std::cout << " " << cardFromCode(log.board[i]).toString();
+                std::cout << "\n";
+            }
+            std::cout << "    " << log.seats[a.seat].name << " " << handActionName(a.type);
+            if (a.amount > 0) std::cout << " " << a.amount;
+            if (a.allIn) std::cout << " (all-in)";
+            std::cout << "\n";
+        }
+        for (const auto& s : log.seats) {
+            if (s.won > 0) std::cout << "  " << s.name << " wins " << s.won << (s.showdown ? " at showdown" : "") << "\n";
+        }
+    }
+    return 0;
+}
+
+// Hooks the game loop calls while a hand is in progress. Cheap no-ops unless
+// the table records history.
+static void logSeatWin(Table& t, const Player& p, int amount) {
+    if (!t.history) return;
+    size_t seat = &p - t.players.data();
+    if (seat < t.handLog.seats.size()) t.handLog.seats[seat].won += amount;
+}
+
+static void logShowdown(Table& t, const Player& p) {
+    if (!t.history) return;
+    size_t seat = &p - t.players.data();
+    if (seat < t.handLog.seats.size()) t.handLog.seats[seat].showdown = true;
+}
+
+static void logBoard(Table& t) {
+    if (!t.history) return;
+    t.handLog.board.clear();
+    for (const auto& c : t.communityCards) t.handLog.board.push_back(cardCode(c));
+}
+
+static void logAction(Table& t, int street, const Player& p, uint8_t type, int amount) {
+    if (!t.history) return;
+    t.handLog.actions.push_back({static_cast<uint8_t>(street), static_cast<uint8_t>(&p - t.players.data()),
+                                 type, p.allIn, amount});
+}
+
+// ===== Opponent Model Store =====
+// Keeps handsPlayed/vpipActions/pfrActions per player name across sessions in
+// a memory-mapped open-addressing hash table, so returning players arrive with
+// a warm model. Each slot holds two copies of the counters with a sequence
+// number and checksum; a save overwrites the older copy, so a write torn by a
+// crash leaves the previous copy intact. The table doubles through a temp
+// file and rename() when it passes 70% full. POSIX only; on Windows open()
+// fails and the server runs without persistence.
+static const char MODEL_MAGIC[8] = {'T', 'C', 'P', 'M', 'O', 'D', 'E', 'L'};
+static const uint32_t MODEL_VERSION = 1;
+static const uint32_t MODEL_INITIAL_SLOTS = 4096; // Power of two
+static const size_t MODEL_NAME_MAX = 47;
+
+struct ModelCounters {
+    uint32_t seq;
+    uint32_t handsPlayed, vpipActions, pfrActions;
+    uint32_t reserved[3];
+    uint32_t checksum; // FNV-1a over the fields above
+};
+
+struct ModelSlot {
+    uint64_t hash; // 0 = empty; written last when a slot is claimed
+    char name[MODEL_NAME_MAX + 1];
+    ModelCounters copies[2];
+    uint8_t pad[8];
+};
+static_assert(sizeof(ModelSlot) == 128, "ModelSlot should stay two cache lines");
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint8_t pad[112];
+};
+static_assert(sizeof(ModelFileHeader) == 128, "Header keeps slots aligned");
+
+class OpponentStore {
+public:
+    ~OpponentStore() { unmap(); }
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        (void)path;
+        return false;
+#else
+        m_path = path;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 && !create(path, MODEL_INITIAL_SLOTS)) return false;
+        if (!map(path)) return false;
+        for (uint32_t i = 0; i < m_capacity; ++i) {
+            if (m_slots[i].hash != 0) m_count++;
+        }
+        return true;
+#endif
+    }
+
+    // Copies a player's saved counters into 'p'. O(1) expected.
+    void load(Player& p) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_slots) return;
+        ModelSlot* s = find(p.name, false);
+        const ModelCounters* c = s ? newest(*s) : nullptr;
+        if (!c) return;
+        p.handsPlayed = c->handsPlayed;
+        p.vpipActions = c->vpipActions;
+        p.pfrActions = c->pfrActions;
+    }
+
+    // Writes a player's current counters, claiming a slot on first sight.
+    void save(const Player& p) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_slots) return;
+        ModelSlot* s = find(p.name, false);
+        if (!s) {
+            if ((m_count + 1) * 10 > (size_t)m_capacity * 7 && !grow()) return;
+            s = find(p.name, true);
+            if (!s) return;
+            m_count++;
+        }
+        const ModelCounters* cur = newest(*s);
+        ModelCounters& dst = (cur == &s->copies[0]) ? s->copies[1] : s->copies[0];
+        ModelCounters c{};
+        c.seq = cur ? cur->seq + 1 : 1;
+        c.handsPlayed = static_cast<uint32_t>(p.handsPlayed);
+        c.vpipActions = static_cast<uint32_t>(p.vpipActions);
+        c.pfrActions = static_cast<uint32_t>(p.pfrActions);
+        c.checksum = counterChecksum(c);
+        dst = c;
+    }
+
+private:
+    static uint64_t nameHash(const std::string& name) {
+        uint64_t h = 1469598103934665603ull; // FNV-1a 64
+        for (size_t i = 0; i < name.size() && i < MODEL_NAME_MAX; ++i) {
+            h ^= static_cast<uint8_t>(name[i]);
+            h *= 1099511628211ull;
+        }
+        return h ? h : 1;
+    }
+
+    static uint32_t counterChecksum(const ModelCounters& c) {
+        return hhChecksum(reinterpret_cast<const uint8_t*>(&c), offsetof(ModelCounters, checksum));
+    }
+
+    static const ModelCounters* newest(const ModelSlot& s) {
+        const ModelCounters* best = nullptr;
+        for (const auto& c : s.copies) {
+            if (c.seq == 0 || counterChecksum(c) != c.checksum) continue;
+            if (!best || c.seq > best->seq) best = &c;
+        }
+        return best;
+    }
+
+    static bool sameName(const ModelSlot& s, const std::string& name) {
+        size_t n = std::min(name.size(), MODEL_NAME_MAX);
+        return std::strncmp(s.name, name.c_str(), n) == 0 && s.name[n] == '\0';
+    }
+
+    // Linear probing. With 'claim', returns the empty slot the name goes in.
+    ModelSlot* find(const std::string& name, bool claim) {
+        uint64_t h = nameHash(name);
+        uint32_t mask = m_capacity - 1;
+        for (uint32_t i = 0, idx = static_cast<uint32_t>(h) & mask; i < m_capacity; ++i, idx = (idx + 1) & mask) {
+            ModelSlot& s = m_slots[idx];
+            if (s.hash == 0) {
+                if (!claim) return nullptr;
+                size_t n = std::min(name.size(), MODEL_NAME_MAX);
+                std::memset(s.name, 0, sizeof(s.name));
+                std::memcpy(s.name, name.data(), n);
+                std::atomic_thread_fence(std::memory_order_release);
+                s.hash = h;
+                return &s;
+            }
+            if (s.hash == h && sameName(s, name)) return &s;
+        }
+        return nullptr;
+    }
+
+#ifndef _WIN32
+    static bool create(const std::string& path, uint32_t capacity) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        ModelFileHeader hdr{};
+        std::memcpy(hdr.magic, MODEL_MAGIC, 8);
+        hdr.version = MODEL_VERSION;
+        hdr.capacity = capacity;
+        bool ok = ftruncate(fd, static_cast<off_t>(sizeof(hdr) + (size_t)capacity * sizeof(ModelSlot))) == 0 &&
+                  pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+        ::close(fd);
+        return ok;
+    }
+
+    bool map(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ModelFileHeader)) { ::close(fd); return false; }
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        auto* hdr = static_cast<ModelFileHeader*>(p);
+        size_t need = sizeof(ModelFileHeader) + (size_t)hdr->capacity * sizeof(ModelSlot);
+        if (std::memcmp(hdr->magic, MODEL_MAGIC, 8) != 0 || hdr->version != MODEL_VERSION ||
+            hdr->capacity == 0 || (hdr->capacity & (hdr->capacity - 1)) != 0 || need > (size_t)st.st_size) {
+            munmap(p, static_cast<size_t>(st.st_size));
+            return false;
+        }
+        m_map = p;
+        m_mapSize = static_cast<size_t>(st.st_size);
+        m_capacity = hdr->capacity;
+        m_slots = reinterpret_cast<ModelSlot*>(static_cast<uint8_t*>(p) + sizeof(ModelFileHeader));
+        return true;
+    }
+
+    // Rehashes into a file twice the size and swaps it in with rename().
+    bool grow() {
+        std::string tmp = m_path + ".tmp";
+        if (!create(tmp, m_capacity * 2)) return false;
+        OpponentStore next;
+        if (!next.map(tmp)) return false;
+        for (uint32_t i = 0; i < m_capacity; ++i) {
+            const ModelSlot& s = m_slots[i];
+            if (s.hash == 0) continue;
+            ModelSlot* d = next.find(std::string(s.name), true);
+            if (!d) return false;
+            std::memcpy(d->copies, s.copies, sizeof(s.copies));
+        }
+        msync(next.m_map, next.m_mapSize, MS_SYNC);
+        next.unmap();
+        if (rename(tmp.c_str(), m_path.c_str()) != 0) return false;
+        unmap();
+        return map(m_path);
+    }
+#else
+    bool grow() { return false; }
+#endif
+
+    void unmap() {
+#ifndef _WIN32
+        if (m_map) munmap(m_map, m_mapSize);
+#endif
+        m_map = nullptr;
+        m_slots = nullptr;
+        m_capacity = 0;
+    }
+
+    std::mutex m_mutex;
+    std::string m_path;
+    void* m_map = nullptr;
+    size_t m_mapSize = 0;
+    ModelSlot* m_slots = nullptr;
+    uint32_t m_capacity = 0;
+    size_t m_count = 0;
+};
+
+// ===== Name Interning =====
+// Connection names are stored once per distinct name and referred to by id;
+// a lobby of 100k clients holds one small id each, not a string each.
+class NameTable {
+public:
+    uint32_t intern(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_ids.find(name);
+        if (it != m_ids.end()) {
+            m_entries[it->second].refs++;
+            return it->second;
+        }
+        uint32_t id;
+        if (!m_free.empty()) {
+            id = m_free.back();
+            m_free.pop_back();
+            m_entries[id].name = name;
+        } else {
+            id = (uint32_t)m_entries.size();
+            m_entries.push_back({name, 0});
+        }
+        m_entries[id].refs = 1;
+        m_ids.emplace(m_entries[id].name, id);
+        return id;
+    }
+
+    void release(uint32_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_entries[id].refs > 0) return;
+        m_ids.erase(m_entries[id].name);
+        std::string().swap(m_entries[id].name);
+        m_free.push_back(id);
+    }
+
+    std::string get(uint32_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries[id].name;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t refs;
+    };
+    std::deque<Entry> m_entries; // Deque: keys in m_ids point into it
+    std::unordered_map<std::string_view, uint32_t> m_ids;
+    std::vector<uint32_t> m_free;
+    std::mutex m_mutex;
+};
+
+NameTable g_names;
+
+// ===== Connection Reactor =====
+// One thread owns every client socket and waits on all of them at once
+// (epoll on Linux, poll() elsewhere). Per connection it keeps a 16-byte
+// record indexed by socket; a line buffer is borrowed from a shared pool only
+// while a partial line (or binary frame) is pending. Complete lines and
+// frames from seated players go to the inbound queue. Clients that arrive to a full table wait in the lobby
+// and are seated in arrival order as seats free up. Until then the socket is
+// non-blocking and what the client is owed (the handshake reply, its place in
+// line) waits in an Outbox, so one that stops reading is dropped instead of
+// stalling the reactor or the game thread. Seating hands the socket back to
+// blocking writes from the game thread. A client whose first line is
+// "WATCH [name]" becomes a spectator instead, fed from the table's SpectatorFeed.
+enum ConnState : uint8_t { CONN_FREE, CONN_HANDSHAKE, CONN_LOBBY, CONN_SEATED, CONN_CLOSED, CONN_WATCHING };
+
+struct Connection {
+    uint32_t nameId = 0;
+    uint32_t buffer = 0;   // Pool block + 1; 0 = no partial line pending
+    uint16_t buffered = 0; // Bytes of the partial line
+    uint8_t state = CONN_FREE;
+    uint8_t gen = 0;       // Bumped on close; lobby entries carry it
+    uint8_t wire = 0;      // Binary protocol version agreed in the handshake; 0 = text
+};
+
+// Bytes the reactor owes a socket it writes without blocking: the
+// handshake reply and lobby notices of a client not yet seated, or a
+// spectator's events.
+struct Outbox {
+    std::deque<SharedText> queue;
+    size_t offset = 0;            // Bytes of queue.front() already sent
+    size_t queuedBytes = 0;
+    bool wantWrite = false;       // Waiting for the socket to drain
+};
+
+// A spectator's unsent events. Entries share the feed's buffers, so a
+// thousand watchers cost a thousand pointers per event, not copies.
+struct Watcher : Outbox {
+    uint64_t cursor = 0;          // Next feed sequence to queue
+};
+
+// Seated sockets go back to blocking: the game thread writes them directly.
+static void setNonBlocking(socket_t s, bool on = true) {
+#ifdef _WIN32
+    u_long mode = on ? 1 : 0;
+    ioctlsocket(s, FIONBIO, &mode);
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    fcntl(s, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+#endif
+}
+
+static bool wouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+// Fixed-size line buffers, handed out and returned by the reactor thread.
+class LineBufferPool {
+public:
+    uint32_t acquire() {
+        if (m_free.empty()) {
+            uint32_t base = (uint32_t)(m_chunks.size() * LINE_POOL_CHUNK);
+            m_chunks.emplace_back(new char[LINE_POOL_CHUNK * LINE_BUFFER_BYTES]);
+            for (uint32_t i = LINE_POOL_CHUNK; i > 0; --i) m_free.push_back(base + i - 1);
         }
-        std::cout << "\r" << std::string(30, ' ') << "\r";
+        uint32_t b = m_free.back();
+        m_free.pop_back();
+        return b;
     }
-    
-    double equity = runMonteCarlo(ai, mainDeck);
-    
-    bool hasFlushDraw = false, hasOESD = false, hasGutshot = false;
-    std::vector<Card> curH = ai.hand;
-    curH.insert(curH.end(), communityCards.begin(), communityCards.end());
-    
-    if (curH.size() >= 4) {
-        std::map<std::string, int> sc;
-        for (const auto& c : curH) sc[c.suit]++;
-        for (auto const& [s, c] : sc) if (c == 4) hasFlushDraw = true;
-        
-        std::set<int> ur;
-        for (const auto& c : curH) ur.insert(getCardValue(c.rank));
-        if (ur.count(14)) ur.insert(1); 
-        
-        for (int r : ur) {
-            if (ur.count(r + 1) && ur.count(r + 2) && ur.count(r + 3)) {
-                hasOESD = true;
-                break;
+
+    void release(uint32_t b) { m_free.push_back(b); }
+
+    char* data(uint32_t b) {
+        return m_chunks[b / LINE_POOL_CHUNK].get() + (size_t)(b % LINE_POOL_CHUNK) * LINE_BUFFER_BYTES;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    std::vector<uint32_t> m_free;
+};
+
+class ConnectionReactor {
+public:
+    ConnectionReactor(Table& t, socket_t listenFd) : m_table(t), m_listen(listenFd) {
+#ifdef __linux__
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        watch(m_listen);
+        watch(m_wake);
+#endif
+        m_table.spectators.onPublish = [this]() { wake(); };
+    }
+
+    ~ConnectionReactor() {
+        m_table.spectators.onPublish = nullptr;
+#ifdef __linux__
+        close(m_epoll);
+        close(m_wake);
+#endif
+    }
+
+    void run() {
+        while (!m_stop) {
+#ifdef __linux__
+            epoll_event events[256];
+            int n = epoll_wait(m_epoll, events, 256, -1);
+            if (n < 0) continue;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == m_listen) onAccept();
+                else if (fd == m_wake) { uint64_t v; while (read(m_wake, &v, sizeof(v)) > 0) {} }
+                else {
+                    if (events[i].events & EPOLLOUT) onWritable(fd);
+                    if (events[i].events & ~EPOLLOUT) onReadable(fd);
+                }
             }
-        }
-        if (!hasOESD) {
-            for (int r : ur) {
-                if ((ur.count(r + 1) && ur.count(r + 3) && ur.count(r + 4)) || // e.g., 5,6, 8,9
-                    (r == 1 && ur.count(2) && ur.count(3) && ur.count(5)) || // A,2,3, 5
-                    (r == 11 && ur.count(12) && ur.count(13) && ur.count(14))) // J,Q,K,A
-                {
-                    hasGutshot = true;
-                    break;
+#else
+            // poll() fallback: rebuilt each pass, with a timeout so releases
+            // queued by the game thread are picked up without a wake-up fd.
+            std::vector<pollfd> fds;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                fds.push_back({m_listen, POLLIN, 0});
+                for (size_t s = 0; s < m_conns.size(); ++s) {
+                    if (m_conns[s].state != CONN_FREE && m_conns[s].state != CONN_CLOSED) {
+                        Outbox* o = outboxOf((socket_t)s);
+                        bool out = o && o->wantWrite;
+                        fds.push_back({(socket_t)s, (short)(out ? POLLIN | POLLOUT : POLLIN), 0});
+                    }
+                }
+            }
+#ifdef _WIN32
+            int n = WSAPoll(fds.data(), (ULONG)fds.size(), 100);
+#else
+            int n = poll(fds.data(), fds.size(), 100);
+#endif
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; n > 0 && i < fds.size(); ++i) {
+                if (!fds[i].revents) continue;
+                if (fds[i].fd == m_listen) onAccept();
+                else {
+                    if (fds[i].revents & POLLOUT) onWritable(fds[i].fd);
+                    if (fds[i].revents & ~POLLOUT) onReadable(fds[i].fd);
                 }
             }
+#endif
+            for (socket_t s : m_closing) closeConnection(s);
+            m_closing.clear();
+            if (!m_watchers.empty() && m_table.spectators.head() != m_pumped) pumpWatchers();
         }
     }
-    bool strongDraw = hasFlushDraw || hasOESD;
-    
-    double requiredEquity = potOdds;
-    if (callAmt > 0) {
-        if (oppIsTight && !oppIsAggressive) requiredEquity *= 1.25;
-        else if (!oppIsTight && oppIsAggressive) requiredEquity *= 0.85;
+
+    // Main thread, at shutdown: run() returns after its current pass.
+    void stop() {
+        m_stop = true;
+        wake();
     }
-    
-    if (strongDraw && callAmt > 0 && callAmt < pot / 2.0) requiredEquity *= 0.75;
-    else if (hasGutshot && callAmt > 0 && callAmt < pot / 3.0) requiredEquity *= 0.90;
-    
-    {
-        std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cout << "AI Debug: E=" << (equity * 100) << "%|Need=" << (potOdds * 100) << "%|AdjNeed=" << (requiredEquity * 100) << "%" << std::endl;
-        if (opponent && opponent->handsPlayed > 10) {
-            std::cout << "AI Debug: Opp VPIP=" << (oppVPIP * 100) << "% PFR=" << (oppPFR * 100) << "%(T=" << oppIsTight << ",A=" << oppIsAggressive << ")" << std::endl;
+
+    // Game thread: hands a removed player's socket back to be closed.
+    void release(socket_t s) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing.push_back(s);
+        wake();
+    }
+
+    // Game thread: fills free seats from the lobby in arrival order.
+    // Nothing here blocks: notices only go as far as each socket takes them.
+    void seatWaiting() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool moved = false;
+        while (!m_lobby.empty() && freeSeats() > 0) {
+            uint64_t e = m_lobby.front();
+            m_lobby.pop_front();
+            socket_t s = (socket_t)(e >> 8);
+            if ((size_t)s >= m_conns.size()) continue;
+            Connection& c = m_conns[s];
+            if (c.state != CONN_LOBBY || c.gen != (uint8_t)e) continue; // Left or dropped while waiting
+            seat(s, c);
+            moved = true;
         }
-        if (strongDraw) std::cout << "AI Debug: Strong Draw." << std::endl;
-        else if (hasGutshot) std::cout << "AI Debug: Gutshot." << std::endl;
+        if (!moved) return;
+        announceQueue();
+        wake(); // Pick up write interest and drops
     }
-    
-    std::mt19937 rng(std::random_device{}());
-    std::uniform_int_distribution<int> dist(1, 100);
-    
-    if (callAmt == 0) {
-        // --- Bluffing Logic (10% chance on turn/river if checked to) ---
-        if ((roundNumber == 2 || roundNumber == 3) && opponent != nullptr && dist(rng) <= 10) {
-            int bAmt = pot / 2;
-            if (bAmt < 50) bAmt = 50;
-            if (bAmt > ai.chips) bAmt = ai.chips;
-            if (bAmt <= 0) return "CHECK";
-            {
-                std::lock_guard<std::mutex> lock(g_io_mutex);
-                std::cout << "AI Debug: Bluff bet." << std::endl;
+
+    size_t lobbySize() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lobby.size();
+    }
+
+private:
+    Table& m_table;
+    socket_t m_listen;
+    int m_epoll = -1;
+    int m_wake = -1;
+    std::vector<Connection> m_conns; // Indexed by socket
+    std::deque<uint64_t> m_lobby;    // socket << 8 | gen
+    std::vector<socket_t> m_closing;
+    std::unordered_map<socket_t, Outbox> m_outboxes; // Handshake and lobby clients with unsent notices
+    std::unordered_map<socket_t, Watcher> m_watchers;
+    std::vector<SharedText> m_feedBuf; // Reused by pumpWatchers()
+    uint64_t m_pumped = 0;             // Feed head the watchers were last filled to
+    LineBufferPool m_pool;
+    char m_readBuf[64 * 1024];
+    std::mutex m_mutex;
+    std::atomic<bool> m_stop{false};
+
+    void watch(socket_t s, bool writable = false, bool modify = false) {
+#ifdef __linux__
+        epoll_event ev = {};
+        ev.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.fd = s;
+        epoll_ctl(m_epoll, modify ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, s, &ev);
+#else
+        (void)s;
+        (void)writable;
+        (void)modify;
+#endif
+    }
+
+    void wake() {
+#ifdef __linux__
+        uint64_t one = 1;
+        if (write(m_wake, &one, sizeof(one)) < 0) {}
+#endif
+    }
+
+    int freeSeats() {
+        std::lock_guard<std::mutex> lock(m_table.playersMutex);
+        return m_table.maxSeats - (int)m_table.players.size();
+    }
+
+    void onAccept() {
+        struct sockaddr_in address;
+        socklen_t addrlen = sizeof(address);
+        socket_t s = accept(m_listen, (struct sockaddr*)&address, &addrlen);
+        if (s == INVALID_SOCKET_VAL) return;
+        // Enable keepalive and disable SIGPIPE on this socket (macOS)
+        int one = 1;
+#ifdef _WIN32
+        setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, (const char*)&one, sizeof(one));
+#else
+        setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+#endif
+#ifdef SO_NOSIGPIPE
+        setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        if ((size_t)s >= m_conns.size()) m_conns.resize(std::max<size_t>((size_t)s + 1, m_conns.size() * 2));
+        resetRecord(m_conns[s]);
+        m_conns[s].state = CONN_HANDSHAKE;
+        setNonBlocking(s);
+        watch(s);
+    }
+
+    void onReadable(socket_t s) {
+        if ((size_t)s >= m_conns.size()) return;
+        Connection& c = m_conns[s];
+        if (c.state == CONN_FREE || c.state == CONN_CLOSED) return;
+        int n = READSOCK(s, m_readBuf, sizeof(m_readBuf));
+        if (n < 0 && wouldBlock()) return;
+        if (n <= 0) {
+            onHangup(s, c);
+            return;
+        }
+        size_t start = 0;
+        for (int i = 0; i < n && !c.wire && c.state != CONN_CLOSED; ++i) {
+            if (m_readBuf[i] != '\n') continue;
+            std::string line;
+            if (c.buffer) {
+                line.assign(m_pool.data(c.buffer - 1), c.buffered);
+                m_pool.release(c.buffer - 1);
+                c.buffer = 0;
+                c.buffered = 0;
             }
-            return "RAISE " + std::to_string(bAmt);
+            line.append(m_readBuf + start, i - start);
+            line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+            start = i + 1;
+            onLine(s, c, line);
         }
-        
-        // --- Value Betting ---
-        if (equity > 0.6 || strongDraw) {
-            int bAmt = pot / 2;
-            if (bAmt < 50) bAmt = 50;
-            if (bAmt > ai.chips) bAmt = ai.chips;
-            if (bAmt <= 0) return "CHECK";
-            return "RAISE " + std::to_string(bAmt);
-        } else {
-            return "CHECK";
+        if (c.state == CONN_CLOSED) return; // Dropped while answering
+        if (c.wire) {
+            // The rest of the read, after the handshake line, is frames.
+            if (!onFrames(s, c, m_readBuf + start, n - start)) onHangup(s, c);
+            return;
         }
-    } else {
-        if (equity > requiredEquity) {
-            // --- Semi-bluff Raise (20% chance with strong draw) ---
-            if (strongDraw && dist(rng) <= 20) {
-                int rAmt = callAmt * 2 + pot;
-                if (rAmt > ai.chips) rAmt = ai.chips;
-                if (rAmt <= callAmt) return "CALL";
-                {
-                    std::lock_guard<std::mutex> lock(g_io_mutex);
-                    std::cout << "AI Debug: Semi-bluff raise." << std::endl;
+        if (start < (size_t)n) {
+            if (!c.buffer) c.buffer = m_pool.acquire() + 1;
+            size_t take = std::min<size_t>(n - start, LINE_BUFFER_BYTES - c.buffered); // Overlong lines are cut
+            std::memcpy(m_pool.data(c.buffer - 1) + c.buffered, m_readBuf + start, take);
+            c.buffered += (uint16_t)take;
+        }
+    }
+
+    void onLine(socket_t s, Connection& c, const std::string& line) {
+        if (c.state == CONN_SEATED) {
+            postInbound({s, line});
+        } else if (c.state == CONN_HANDSHAKE && (line == "WATCH" || line.rfind("WATCH ", 0) == 0)) {
+            c.nameId = g_names.intern(line.size() > 6 ? line.substr(6) : "spectator");
+            startWatching(s, c);
+        } else if (c.state == CONN_HANDSHAKE && line.rfind("PROTO ", 0) == 0) {
+            // "PROTO <version> <name>": answer with the version both speak.
+            size_t nameAt = line.find(' ', 6);
+            c.wire = (uint8_t)std::min(std::max(std::atoi(line.c_str() + 6), 0), WIRE_VERSION);
+            join(s, c, nameAt == std::string::npos ? "" : line.substr(nameAt + 1), "PROTO " + std::to_string(c.wire) + "\n");
+        } else if (c.state == CONN_HANDSHAKE) {
+            join(s, c, line);
+        }
+        // Lobby clients and spectators have nothing to act on; their input is dropped.
+    }
+
+    // Splits a binary client's bytes into frames; a partial frame waits in a
+    // pool buffer like a partial line. False on a frame too long to be one
+    // of ours.
+    bool onFrames(socket_t s, Connection& c, const char* data, size_t len) {
+        while (len > 0) {
+            if (!c.buffer && len >= WIRE_HEADER) {
+                size_t size = WIRE_HEADER + wireLength(data);
+                if (size > LINE_BUFFER_BYTES) return false;
+                if (len >= size) {
+                    onFrame(s, c, (uint8_t)data[0], data + WIRE_HEADER, size - WIRE_HEADER);
+                    data += size;
+                    len -= size;
+                    continue;
                 }
-                return "RAISE " + std::to_string(rAmt);
             }
-            
-            // --- Value Raise ---
-            if (equity > 0.85 && !strongDraw) {
-                int rAmt = callAmt * 2 + pot;
-                if (rAmt > ai.chips) rAmt = ai.chips;
-                if (rAmt <= callAmt) return "CALL";
-                return "RAISE " + std::to_string(rAmt);
+            if (!c.buffer) c.buffer = m_pool.acquire() + 1;
+            char* buf = m_pool.data(c.buffer - 1);
+            size_t want = c.buffered < WIRE_HEADER ? WIRE_HEADER : WIRE_HEADER + wireLength(buf);
+            if (want > LINE_BUFFER_BYTES) return false;
+            size_t take = std::min(want - c.buffered, len);
+            std::memcpy(buf + c.buffered, data, take);
+            c.buffered += (uint16_t)take;
+            data += take;
+            len -= take;
+            if (c.buffered >= WIRE_HEADER && c.buffered == WIRE_HEADER + wireLength(buf)) {
+                onFrame(s, c, (uint8_t)buf[0], buf + WIRE_HEADER, c.buffered - WIRE_HEADER);
+                m_pool.release(c.buffer - 1);
+                c.buffer = 0;
+                c.buffered = 0;
             }
-            return "CALL";
+        }
+        return true;
+    }
+
+    void onFrame(socket_t s, Connection& c, uint8_t type, const char* payload, size_t len) {
+        if (c.state != CONN_SEATED) return;
+        Message m{s, ""};
+        if (type == WF_ACTION && len >= 5) {
+            m.move.kind = (uint8_t)payload[0] <= HA_RAISE ? (uint8_t)payload[0] : ACTION_UNKNOWN;
+            m.move.amount = (int)std::min<uint32_t>(wireGet32(payload + 1), std::numeric_limits<int>::max());
+        } else if (type == WF_CHAT) {
+            m.data.assign("CHAT:").append(payload, len);
         } else {
-            {
-                std::lock_guard<std::mutex> lock(g_io_mutex);
-                std::cout << "AI Debug: Folding. E " << (equity * 100) << "% < Req " << (requiredEquity * 100) << "%." << std::endl;
+            return; // Nothing else is sent to the server
+        }
+        postInbound(std::move(m));
+    }
+
+    // Seats the client, or queues it in the lobby while the table is full.
+    // reply is the handshake's answer, which goes out first.
+    void join(socket_t s, Connection& c, const std::string& name, std::string reply = "") {
+        c.nameId = g_names.intern(name);
+        c.state = CONN_LOBBY; // Named, so a drop from here on releases the name
+        if (!reply.empty()) post(s, c, std::move(reply));
+        if (c.state == CONN_CLOSED) return;
+        if (freeSeats() > 0 && m_lobby.empty()) {
+            seat(s, c);
+        } else {
+            m_lobby.push_back(((uint64_t)s << 8) | c.gen);
+            sendText(s, c, "LOBBY Table full. You are number " + std::to_string(m_lobby.size()) +
+                           " in line for a seat.");
+        }
+    }
+
+    void sendText(socket_t s, Connection& c, const std::string& text) {
+        std::string out;
+        if (c.wire) wireText(out, text);
+        else out = text + "\n";
+        post(s, c, std::move(out));
+    }
+
+    // Queues bytes for a client that is not seated yet and sends what the
+    // socket takes now.
+    void post(socket_t s, Connection& c, std::string bytes) {
+        if (c.state == CONN_CLOSED) return;
+        Outbox& o = m_outboxes[s];
+        enqueue(o, std::make_shared<const std::string>(std::move(bytes)));
+        if (!flushOutbox(s, o) || o.queuedBytes > LOBBY_MAX_QUEUED) drop(s, c);
+    }
+
+    // Not closed here: a caller up the stack may still be using the record.
+    void drop(socket_t s, Connection& c) {
+        c.state = CONN_CLOSED;
+        m_closing.push_back(s);
+    }
+
+    void onHangup(socket_t s, Connection& c) {
+        if (c.state == CONN_SEATED) {
+            // The seat keeps the socket until the player is removed, so the
+            // descriptor cannot be reused while the game still refers to it.
+            c.state = CONN_CLOSED;
+#ifdef __linux__
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, s, nullptr);
+#endif
+            postInbound({s, "DISCONNECTED"});
+            return;
+        }
+        closeConnection(s);
+    }
+
+    // Returns the record's buffer and name and invalidates lobby entries.
+    void resetRecord(Connection& c) {
+        if (c.state == CONN_FREE) return;
+        if (c.buffer) m_pool.release(c.buffer - 1);
+        if (c.state != CONN_HANDSHAKE) g_names.release(c.nameId);
+        uint8_t gen = c.gen + 1;
+        c = Connection();
+        c.gen = gen;
+    }
+
+    void closeConnection(socket_t s) {
+        if ((size_t)s < m_conns.size()) {
+            if (m_conns[s].state == CONN_WATCHING) {
+                m_watchers.erase(s);
+                m_table.spectators.watchers--;
             }
-            return "FOLD";
+            m_outboxes.erase(s);
+            resetRecord(m_conns[s]);
         }
+        CLOSESOCK(s); // Also drops it from the epoll set
+    }
+
+    // Called with m_mutex held. The watcher starts at the feed's head with
+    // the latest table display.
+    void startWatching(socket_t s, Connection& c) {
+        c.state = CONN_WATCHING;
+        int sndbuf = SPECTATOR_SNDBUF;
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&sndbuf, sizeof(sndbuf));
+        m_table.spectators.watchers++;
+        Watcher& w = m_watchers[s];
+        w.cursor = m_table.spectators.head();
+        enqueue(w, std::make_shared<const std::string>("WATCHING\n"));
+        if (SharedText snap = m_table.spectators.snapshot()) enqueue(w, snap);
+        if (!flushOutbox(s, w)) {
+            m_closing.push_back(s); // Not here: onReadable() is still using the record
+            return;
+        }
+        std::lock_guard<std::mutex> io(g_io_mutex);
+        std::cout << g_names.get(c.nameId) << " is watching.\n";
+    }
+
+    static void enqueue(Outbox& o, SharedText text) {
+        o.queuedBytes += text->size();
+        o.queue.push_back(std::move(text));
+    }
+
+    // Called with m_mutex held, after the feed moved on. The feed is read
+    // once for all watchers. One that lost events to the backlog, or has
+    // more than SPECTATOR_MAX_QUEUED bytes unsent, drops its queue (all but
+    // a partly sent line) and gets RESYNC plus the latest snapshot instead.
+    void pumpWatchers() {
+        uint64_t from = UINT64_MAX, head;
+        for (auto& kv : m_watchers) from = std::min(from, kv.second.cursor);
+        uint64_t first = m_table.spectators.since(from, m_feedBuf, head);
+        SharedText snap = m_table.spectators.snapshot();
+        std::vector<socket_t> dead;
+        for (auto& kv : m_watchers) {
+            Watcher& w = kv.second;
+            bool lost = w.cursor < first;
+            for (uint64_t seq = std::max(w.cursor, first); seq < head; ++seq) enqueue(w, m_feedBuf[seq - first]);
+            w.cursor = head;
+            if (lost || w.queuedBytes > SPECTATOR_MAX_QUEUED) {
+                size_t keep = w.offset ? 1 : 0;
+                while (w.queue.size() > keep) {
+                    w.queuedBytes -= w.queue.back()->size();
+                    w.queue.pop_back();
+                }
+                enqueue(w, std::make_shared<const std::string>("RESYNC\n"));
+                if (snap) enqueue(w, snap);
+            }
+            if (!flushOutbox(kv.first, w)) dead.push_back(kv.first);
+        }
+        m_feedBuf.clear(); // Drop the references until the next pump
+        m_pumped = head;
+        for (socket_t s : dead) closeConnection(s);
+    }
+
+    Outbox* outboxOf(socket_t s) {
+        auto w = m_watchers.find(s);
+        if (w != m_watchers.end()) return &w->second;
+        auto o = m_outboxes.find(s);
+        return o != m_outboxes.end() ? &o->second : nullptr;
     }
-}
 
+    void onWritable(socket_t s) {
+        Outbox* o = outboxOf(s);
+        if (o && !flushOutbox(s, *o)) closeConnection(s);
+    }
+
+    // Sends what the socket takes without blocking; false on a send error.
+    bool flushOutbox(socket_t s, Outbox& o) {
+        while (!o.queue.empty()) {
+            const std::string& text = *o.queue.front();
+            int n = (int)send(s, text.data() + o.offset, (int)(text.size() - o.offset), 0);
+            if (n < 0) {
+                if (wouldBlock()) break;
+                return false;
+            }
+            o.offset += (size_t)n;
+            o.queuedBytes -= (size_t)n;
+            if (o.offset == text.size()) {
+                o.queue.pop_front();
+                o.offset = 0;
+            }
+        }
+        bool pending = !o.queue.empty();
+        if (pending != o.wantWrite) {
+            o.wantWrite = pending;
+            watch(s, pending, true);
+        }
+        return true;
+    }
+
+    // Called with m_mutex held. The welcome has to be out before the socket
+    // goes back to blocking writes from the game thread; a client too far
+    // behind for that is dropped and the seat stays free.
+    void seat(socket_t s, Connection& c) {
+        std::string name = g_names.get(c.nameId);
+        sendText(s, c, "WELCOME " + name);
+        if (c.wire) {
+            // Frames only: a text client would print the line.
+            std::string f;
+            wireBegin(f, WF_GAME);
+            wirePut8(f, (uint8_t)m_table.variant);
+            wireEnd(f);
+            post(s, c, std::move(f));
+        }
+        if (c.state != CONN_CLOSED && !m_outboxes[s].queue.empty()) drop(s, c);
+        if (c.state == CONN_CLOSED) return;
+        m_outboxes.erase(s);
+        setNonBlocking(s, false);
+        {
+            std::lock_guard<std::mutex> lock(m_table.playersMutex);
+            Player p;
+            p.name = name;
+            p.socket = s;
+            p.chips = m_table.startingChips;
+            p.timeBankMs = m_table.timeBankMs;
+            p.folded = m_table.handInProgress; // Sit out the hand in progress
+            p.wire = c.wire;
+            if (m_table.models) m_table.models->load(p);
+            g_connections.bind(s, m_table.id, m_table.players.push_back(std::move(p)));
+            if (c.wire) m_table.wireSeats = 0; // Its first WF_STATE has to cover every seat
+        }
+        c.state = CONN_SEATED;
+        std::lock_guard<std::mutex> io(g_io_mutex);
+        std::cout << name << " connected.\n";
+    }
+
+    void announceQueue() {
+        size_t pos = 0;
+        for (uint64_t e : m_lobby) {
+            socket_t s = (socket_t)(e >> 8);
+            if (m_conns[s].state != CONN_LOBBY || m_conns[s].gen != (uint8_t)e) continue;
+            sendText(s, m_conns[s], "LOBBY You are number " + std::to_string(++pos) + " in line for a seat.");
+        }
+    }
+};
 
 // ===== Table Display =====
-void showTable() {
-        std::stringstream ss;
+// WF_STATE with the pot and every seat that changed since the last one.
+// Called with playersMutex held.
+static void encodeState(Table& t, std::string& f) {
+    wireBegin(f, WF_STATE);
+    wirePut32(f, (uint32_t)t.pot);
+    wirePut8(f, (uint8_t)t.players.size());
+    for (size_t i = 0; i < t.players.size(); ++i) {
+        const Player& p = t.players[i];
+        uint8_t flags = (p.folded ? WS_FOLDED : 0) | (p.allIn ? WS_ALL_IN : 0) | (p.isConnected ? 0 : WS_OFFLINE);
+        WireSeat& w = t.wireSent[i];
+        if (i < t.wireSeats && w.chips == p.chips && w.flags == flags && w.name == p.name) continue;
+        w.name = p.name;
+        w.chips = p.chips;
+        w.flags = flags;
+        wirePut8(f, (uint8_t)i);
+        wirePut8(f, flags);
+        wirePut32(f, (uint32_t)p.chips);
+        wirePutName(f, p.name);
+    }
+    t.wireSeats = t.players.size();
+    wireEnd(f);
+}
+
+void showTable(Table& t) {
+    if (t.headless) return;
+    TraceSpan span("show table");
+    std::string& out = t.displayBuf;
+    out.clear();
+    std::string frame;
+    bool wire = false; // Any binary client seated; only then are frames built
     
     // --- NEW: Player Table Formatting ---
-    ss << "\n";
+    out += "\n";
     {
-        std::lock_guard<std::mutex> lock(g_players_mutex);
-        ss << "┌───────────────────┬──────────────┬──────────┐\n";
-        ss << "│ Player            │ Chips        │ Status   │\n";
-        ss << "├───────────────────┼──────────────┼──────────┤\n";
-        for (auto &p : players) {
+        std::lock_guard<std::mutex> lock(t.playersMutex);
+        out += "┌───────────────────┬──────────────┬──────────┐\n";
+        out += "│ Player            │ Chips        │ Status   │\n";
+        out += "├───────────────────┼──────────────┼──────────┤\n";
+        for (auto &p : t.players) {
             char buffer[100];
-            std::string status = "ACTIVE";
+            const char* status = "ACTIVE";
             if (!p.isConnected) status = "OFFLINE";
             else if (p.folded) status = "FOLDED";
             else if (p.allIn) status = "ALL-IN";
             
-            snprintf(buffer, 100, "│ %-17s │ %-12d │ %-8s │", p.name.substr(0, 17).c_str(), p.chips, status.c_str()); 
-            ss << buffer << "\n";
+            snprintf(buffer, 100, "│ %-17.17s │ %-12d │ %-8s │\n", p.name.c_str(), p.chips, status); 
+            out += buffer;
         }
-        ss << "└───────────────────┴──────────────┴──────────┘\n";
-        ss << "Pot: " << pot << "\n"; 
+        out += "└───────────────────┴──────────────┴──────────┘\n";
+        out += "Pot: ";
+        out += std::to_string(t.pot);
+        out += "\n"; 
+        for (auto& p : t.players) wire |= p.wire && p.isConnected;
+        if (wire) encodeState(t, frame);
     }
     
-    broadcast(ss.str());
+    broadcast(t, out, wire ? &frame : nullptr);
+    {
+        std::lock_guard<std::mutex> lock(g_io_mutex);
+        std::cout << out;
+    }
+    // Like publish(), the snapshot is only built for an audience.
+    bool watched = t.spectators.watchers.load(std::memory_order_relaxed) > 0;
+    std::string snapshot;
+    if (watched) snapshot = out + "\n";
     
-    if (communityCards.size() > 0) {
-        std::stringstream ss_cards;
-        ss_cards << "CARDS";
-        for (auto& c : communityCards) {
-            ss_cards << " " << c.toString();
+    if (t.communityCards.size() > 0) {
+        out.assign("CARDS");
+        for (auto& c : t.communityCards) {
+            out += ' ';
+            out += c.toString();
+        }
+        if (wire) {
+            wireBegin(frame, WF_BOARD);
+            wirePutCards(frame, t.communityCards);
+            wireEnd(frame);
         }
-        broadcast(ss_cards.str());
+        broadcast(t, out, wire ? &frame : nullptr);
+        if (watched) snapshot += out + "\n";
+
+        std::lock_guard<std::mutex> lock(g_io_mutex);
+        std::cout << "Community Cards:\n" << displayCards(t.communityCards);
     }
+    if (watched) t.spectators.setSnapshot(std::move(snapshot));
+    else t.spectators.dropSnapshot();
+}
+
+// ===== Reset Function =====
+void resetForNextHand(Table& t) {
+    TraceSpan span("reset");
+    std::vector<socket_t> released;
+    std::unique_lock<std::mutex> lock(t.playersMutex);
+    t.pot = 0;
+    t.currentBet = 0;
+    t.preFlopRaiseMade = false;
+    t.preflopRaises = 0;
+    t.preflopAggressor = -1;
+    t.lastAggressor = -1;
+    t.streetRaises = 0;
+    t.streetActions = 0;
+    t.handRaises = 0;
+    t.equityBoard = -1;
     
-    {
-        std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cout << ss.str();
-        if (communityCards.size() > 0) {
-            std::cout << "Community Cards:\n" << displayCards(communityCards);
+    for (auto it = t.players.begin(); it != t.players.end();) {
+        if (!it->isConnected || it->chips <= 0) {
+            if (!it->isAI) {
+                std::cout << it->name << " removed." << std::endl;
+            }
+            g_connections.unbind(it->socket, t.id, t.players.handleOf(*it));
+            if (it->socket != INVALID_SOCKET_VAL) released.push_back(it->socket);
+            t.seatStats.eraseSeat(it - t.players.begin());
+            it = t.players.erase(it);
+        } else {
+            it->folded = false;
+            it->allIn = false;
+            it->currentBet = 0;
+            ++it;
+        }
+    }
+
+    // Drop every container backed by the hand arena, then rewind it.
+    std::pmr::memory_resource* mr = t.arena.resource();
+    for (auto& p : t.players) CardList(mr).swap(p.hand);
+    CardList(mr).swap(t.communityCards);
+    CardList(mr).swap(t.deck);
+    t.arena.reset();
+    uint64_t hand = deriveKey(t.seed, ++t.handSeq);
+    t.dealRng = CounterRng(deriveKey(hand, RNG_DEAL));
+    t.rng = CounterRng(deriveKey(hand, RNG_AI));
+    createDeck(t);
+    shuffleDeck(t);
+    lock.unlock();
+
+    // The reactor takes playersMutex itself, so call it unlocked.
+    if (t.reactor) {
+        for (socket_t s : released) t.reactor->release(s);
+        t.reactor->seatWaiting();
+    }
+}
+
+// ===== Handle Incoming Messages =====
+void handleIncomingMessage(Table& t, socket_t s, const std::string& d) {
+    Player* p = getPlayerBySocket(t, s);
+    if (!p) return;
+    
+    if (d == "DISCONNECTED") {
+        p->isConnected = false;
+        p->folded = true;
+        broadcast(t, p->name + " disconnected.");
+    } else if (d.find("CHAT:") == 0) {
+        broadcastChat(t, p->name, d.substr(5));
+    }
+}
+
+// ===== Turn Timers =====
+// One hashed timer wheel serves every table in the process. A single thread
+// blocks on a timerfd (a timed condition variable where timerfd is missing)
+// and only ticks while timers are pending. An expired timer is posted to the
+// inbound queue like client input, so the table waiting on that player wakes
+// up and applies the default action itself.
+class TimerWheel {
+public:
+    TimerWheel() : m_slots(TIMER_WHEEL_SLOTS) {}
+
+    ~TimerWheel() {
+        if (!m_thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+#ifdef __linux__
+        itimerspec now = {};
+        now.it_value.tv_nsec = 1;
+        timerfd_settime(m_fd, 0, &now, nullptr);
+#endif
+        m_cv.notify_all();
+        m_thread.join();
+#ifdef __linux__
+        close(m_fd);
+#endif
+    }
+
+    // Posts {socket, timerId} to the inbound queue after delayMs. Returns the id.
+    uint64_t schedule(socket_t socket, int delayMs) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_thread.joinable()) {
+#ifdef __linux__
+            m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+#endif
+            m_thread = std::thread(&TimerWheel::run, this);
+        }
+        size_t ticks = std::max<size_t>(1, (delayMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS);
+        size_t slot = (m_cursor + ticks) % m_slots.size();
+        uint64_t id = m_nextId++;
+        m_slots[slot].push_back({id, socket, (uint32_t)((ticks - 1) / m_slots.size())});
+        m_slotOf[id] = slot;
+        if (m_slotOf.size() == 1) setTicking(true);
+        return id;
+    }
+
+    void cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_slotOf.find(id);
+        if (it == m_slotOf.end()) return;
+        auto& s = m_slots[it->second];
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i].id == id) {
+                s[i] = s.back();
+                s.pop_back();
+                break;
+            }
+        }
+        m_slotOf.erase(it);
+        if (m_slotOf.empty()) setTicking(false);
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        socket_t socket;
+        uint32_t rounds; // Full turns of the wheel left before it fires
+    };
+
+    std::vector<std::vector<Entry>> m_slots;
+    std::unordered_map<uint64_t, size_t> m_slotOf; // Pending id -> slot
+    size_t m_cursor = 0;
+    uint64_t m_nextId = 1;
+    bool m_stop = false;
+    int m_fd = -1;
+    std::chrono::steady_clock::time_point m_lastTick;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+
+    // Called with m_mutex held.
+    void setTicking(bool on) {
+        m_lastTick = std::chrono::steady_clock::now();
+#ifdef __linux__
+        itimerspec spec = {};
+        if (on) {
+            spec.it_interval.tv_nsec = TIMER_TICK_MS * 1000000L;
+            spec.it_value = spec.it_interval;
+        }
+        timerfd_settime(m_fd, 0, &spec, nullptr);
+#else
+        if (on) m_cv.notify_all();
+#endif
+    }
+
+    void advance() {
+        m_cursor = (m_cursor + 1) % m_slots.size();
+        auto& s = m_slots[m_cursor];
+        for (size_t i = 0; i < s.size();) {
+            if (s[i].rounds > 0) {
+                s[i].rounds--;
+                ++i;
+                continue;
+            }
+            postInbound({s[i].socket, "", s[i].id});
+            m_slotOf.erase(s[i].id);
+            s[i] = s.back();
+            s.pop_back();
         }
     }
-}
 
-// ===== Reset Function =====
-void resetForNextHand() {
-    std::lock_guard<std::mutex> lock(g_players_mutex);
-    pot = 0;
-    currentBet = 0;
-    communityCards.clear();
-    g_preFlopRaiseMade = false;
-    
-    for (auto it = players.begin(); it != players.end();) {
-        if (!it->isConnected || it->chips <= 0) {
-            if (!it->isAI) {
-                std::cout << it->name << " removed." << std::endl;
+    void run() {
+        while (true) {
+            uint64_t ticks = 0;
+#ifdef __linux__
+            if (read(m_fd, &ticks, sizeof(ticks)) != (ssize_t)sizeof(ticks)) continue;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop) return;
+#else
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_slotOf.empty()) {
+                m_cv.wait(lock, [this]() { return m_stop || !m_slotOf.empty(); });
+            } else {
+                m_cv.wait_for(lock, std::chrono::milliseconds(TIMER_TICK_MS));
             }
-            it = players.erase(it);
-        } else {
-            it->hand.clear();
-            it->folded = false;
-            it->allIn = false;
-            it->currentBet = 0;
-            ++it;
+            if (m_stop) return;
+            auto elapsed = std::chrono::steady_clock::now() - m_lastTick;
+            ticks = elapsed / std::chrono::milliseconds(TIMER_TICK_MS);
+            m_lastTick += ticks * std::chrono::milliseconds(TIMER_TICK_MS);
+#endif
+            while (ticks-- > 0 && !m_slotOf.empty()) advance();
+            if (m_slotOf.empty()) setTicking(false);
         }
     }
-    createDeck();
-    shuffleDeck();
+};
+
+TimerWheel g_turnTimers;
+
+// ===== Player Input =====
+// A move typed by a text client. Matches the substring rules the text
+// protocol always had; a RAISE without a readable amount raises 50.
+PlayerAction parseAction(const std::string& action) {
+    if (action.find("FOLD") != std::string::npos) return {HA_FOLD, 0};
+    if (action.find("CHECK") != std::string::npos) return {HA_CHECK, 0};
+    if (action.find("CALL") != std::string::npos) return {HA_CALL, 0};
+    if (action.find("RAISE") != std::string::npos) {
+        int rAmt = 0;
+        try {
+            rAmt = std::stoi(action.substr(action.find(" ") + 1));
+        } catch (...) {
+            rAmt = 50; 
+        }
+        return {HA_RAISE, rAmt};
+    }
+    return {};
 }
 
-// ===== Handle Incoming Messages =====
-void handleIncomingMessage(socket_t s, const std::string& d) {
-    Player* p = getPlayerBySocket(s);
-    if (!p) return;
-    
-    if (d == "DISCONNECTED") {
-        p->isConnected = false;
-        p->folded = true;
-        broadcast(p->name + " disconnected.");
-    } else if (d.find("CHAT:") == 0) {
-        broadcastChat(p->name, d.substr(5));
+// Drops the moves a player sent for a turn that had already timed out. A
+// late move that arrived while an AI acted would otherwise sit in the queue
+// and be taken as the player's action on a later turn.
+void dropStaleMoves(Player& p) {
+    std::lock_guard<std::mutex> lock(g_inbound_mutex);
+    std::queue<Message> keep;
+    while (!g_inbound_messages.empty()) {
+        Message& m = g_inbound_messages.front();
+        bool move = m.socket == p.socket && !m.timerId && m.data != "DISCONNECTED" && m.data.find("CHAT:") != 0;
+        if (!move) keep.push(std::move(m));
+        g_inbound_messages.pop();
     }
+    g_inbound_messages.swap(keep);
+    p.turnExpired = false;
 }
 
-// ===== Player Input =====
-std::string getPlayerInput(Player &p) {
-    sendToPlayer(p, "YOUR_MOVE");
+// Waits for the acting player's move. With a turn clock the player gets
+// turnTimeMs plus whatever is left of their time bank; running out checks
+// if possible and folds otherwise.
+PlayerAction getPlayerInput(Table& t, Player &p) {
+    if (p.turnExpired) dropStaleMoves(p);
+    std::string frame;
+    if (p.wire) {
+        wireBegin(frame, WF_YOUR_MOVE);
+        wirePut32(frame, (uint32_t)(t.currentBet - p.currentBet));
+        wirePut32(frame, (uint32_t)t.pot);
+        wirePut32(frame, (uint32_t)p.chips);
+        wireEnd(frame);
+    }
+    sendToPlayer(p, "YOUR_MOVE", &frame);
+    uint64_t timer = 0;
+    auto started = std::chrono::steady_clock::now();
+    if (t.turnTimeMs > 0) {
+        timer = g_turnTimers.schedule(p.socket, t.turnTimeMs + p.timeBankMs);
+        sendToPlayer(p, "Time to act: " + std::to_string(t.turnTimeMs / 1000) + "s (+" +
+                        std::to_string(p.timeBankMs / 1000) + "s time bank)");
+    }
+    auto stopClock = [&]() {
+        if (!timer) return;
+        g_turnTimers.cancel(timer);
+        int used = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        p.timeBankMs = std::max(0, p.timeBankMs - std::max(0, used - t.turnTimeMs));
+    };
+
     while (true) {
         Message msg;
-        bool found = false;
         {
-            std::lock_guard<std::mutex> lock(g_inbound_mutex);
-            if (!g_inbound_messages.empty()) {
-                msg = g_inbound_messages.front();
-                g_inbound_messages.pop();
-                found = true;
+            std::unique_lock<std::mutex> lock(g_inbound_mutex);
+            g_inbound_cv.wait(lock, []() { return !g_inbound_messages.empty(); });
+            msg = std::move(g_inbound_messages.front());
+            g_inbound_messages.pop();
+        }
+
+        if (msg.timerId) {
+            if (msg.timerId != timer) continue; // Stale: that move already arrived
+            p.timeBankMs = 0;
+            p.turnExpired = true;
+            std::string over;
+            if (p.wire) {
+                wireBegin(over, WF_TURN_OVER);
+                wireEnd(over);
             }
+            sendToPlayer(p, "TURN_OVER", &over); // So the client stops taking moves
+            broadcast(t, p.name + " ran out of time.");
+            return {HA_CHECK, 0}; // bettingRound() folds this when facing a bet
         }
-        
-        if (found) {
-            if (msg.socket == p.socket) {
-                if (msg.data.find("CHAT:") == 0) {
-                    handleIncomingMessage(msg.socket, msg.data);
-                    continue; // Loop again for a move
-                } else if (msg.data == "DISCONNECTED") {
-                    handleIncomingMessage(msg.socket, msg.data);
-                    return "FOLD";
-                }
-                return msg.data;
-            } else {
-                handleIncomingMessage(msg.socket, msg.data);
+        if (msg.socket == p.socket) {
+            if (msg.data.find("CHAT:") == 0) {
+                handleIncomingMessage(t, msg.socket, msg.data);
+                continue; // Loop again for a move
             }
+            stopClock();
+            if (msg.data == "DISCONNECTED") {
+                handleIncomingMessage(t, msg.socket, msg.data);
+                return {HA_FOLD, 0};
+            }
+            return msg.move.kind != ACTION_UNKNOWN ? msg.move : parseAction(msg.data);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        handleIncomingMessage(t, msg.socket, msg.data);
     }
 }
 
 // ===== Betting Round =====
-void bettingRound(int roundNumber) {
-    int raises = 0;
-    currentBet = 0;
+void bettingRound(Table& t, int roundNumber) {
+    static const char* const spans[] = {"preflop", "flop", "turn", "river"};
+    TraceSpan span(spans[roundNumber]);
+    SeatMap& players = t.players;
+    t.currentBet = 0;
+    t.lastAggressor = -1;
+    t.streetRaises = 0;
+    t.streetActions = 0;
     for (auto& p : players) {
         p.currentBet = 0;
     }
@@ -693,90 +4496,124 @@ void bettingRound(int roundNumber) {
         }
         if (active <= 1) break;
         
-        Player& p = players[turn % players.size()];
+        int seat = turn % players.size();
+        Player& p = players[seat];
         
         if (!p.folded && !p.allIn && p.isConnected) {
-            showTable();
-            std::string action;
+            showTable(t);
+            PlayerAction action;
             
             if (p.isAI) {
-                action = AIAction(p, roundNumber, deck);
+                TraceSpan decision("ai decision", "seat", seat);
+                action = parseAction(AIAction(t, p, roundNumber));
             } else {
-                action = getPlayerInput(p);
+                TraceSpan decision("player input", "seat", seat);
+                action = getPlayerInput(t, p);
             }
             
-            int callAmt = currentBet - p.currentBet;
+            int callAmt = t.currentBet - p.currentBet;
+            bool facingBet = callAmt > 0;
+            bool threeBetSpot = roundNumber == 0 && t.preflopRaises == 1 && t.preflopAggressor != seat;
+            bool cbetSpot = roundNumber == 1 && t.preflopAggressor == seat && t.currentBet == 0;
             bool voluntary = false;
             bool isRaise = false;
+            uint8_t logType = HA_FOLD;
+            int logAmount = 0;
+            // Text clients get the sentence, binary ones the WF_ACTION frame.
+            auto announce = [&](const std::string& text, uint8_t kind, int amount) {
+                if (t.headless) return;
+                std::string frame;
+                wireBegin(frame, WF_ACTION);
+                wirePut8(frame, kind);
+                wirePut8(frame, p.allIn ? 1 : 0);
+                wirePut32(frame, (uint32_t)amount);
+                wirePutName(frame, p.name);
+                wireEnd(frame);
+                broadcast(t, text, &frame);
+            };
             
-            if (action.find("FOLD") != std::string::npos) {
+            if (action.kind == HA_FOLD) {
                 p.folded = true;
-                broadcast(p.name + " folds.");
-            } else if (action.find("CHECK") != std::string::npos) {
+                announce(p.name + " folds.", HA_FOLD, 0);
+            } else if (action.kind == HA_CHECK) {
                 if (callAmt == 0) {
-                    broadcast(p.name + " checks.");
+                    announce(p.name + " checks.", HA_CHECK, 0);
+                    logType = HA_CHECK;
                 } else {
-                    broadcast(p.name + " folded.");
+                    announce(p.name + " folded.", HA_FOLD, 0);
                     p.folded = true;
                 }
-            } else if (action.find("CALL") != std::string::npos) {
+            } else if (action.kind == HA_CALL) {
                 if (callAmt == 0) {
-                    broadcast(p.name + " checks.");
+                    announce(p.name + " checks.", HA_CHECK, 0);
+                    logType = HA_CHECK;
                 } else {
                     if (callAmt >= p.chips) {
                         callAmt = p.chips;
                         p.allIn = true;
-                        broadcast(p.name + " calls ALL-IN!");
+                        announce(p.name + " calls ALL-IN!", HA_CALL, callAmt);
                     } else {
-                        broadcast(p.name + " calls " + std::to_string(callAmt) + ".");
+                        announce(p.name + " calls " + std::to_string(callAmt) + ".", HA_CALL, callAmt);
                     }
                     p.chips -= callAmt;
-                    pot += callAmt;
+                    t.pot += callAmt;
                     p.currentBet += callAmt;
                     voluntary = true;
+                    logType = HA_CALL;
+                    logAmount = callAmt;
                 }
-            } else if (action.find("RAISE") != std::string::npos) {
-                int rAmt = 0;
-                try {
-                    rAmt = std::stoi(action.substr(action.find(" ") + 1));
-                } catch (...) {
-                    rAmt = 50; 
-                }
-                
-                int total = currentBet + rAmt;
+            } else if (action.kind == HA_RAISE) {
+                int rAmt = action.amount;
+                int total = t.currentBet + rAmt;
                 int putIn = total - p.currentBet;
                 
                 if (putIn >= p.chips) {
                     putIn = p.chips;
                     total = p.currentBet + putIn;
                     p.allIn = true;
-                    broadcast(p.name + " raises ALL-IN!");
+                    announce(p.name + " raises ALL-IN!", HA_RAISE, total - t.currentBet);
                 } else {
-                    broadcast(p.name + " raises " + std::to_string(rAmt) + ".");
+                    announce(p.name + " raises " + std::to_string(rAmt) + ".", HA_RAISE, rAmt);
                 }
                 
                 p.chips -= putIn;
-                pot += putIn;
+                t.pot += putIn;
                 p.currentBet = total;
-                currentBet = total;
-                raises++;
+                t.currentBet = total;
+                t.streetRaises++;
                 voluntary = true;
                 isRaise = true;
+                logType = HA_RAISE;
+                logAmount = putIn;
             } else {
-                broadcast(p.name + " folded.");
+                announce(p.name + " folded.", HA_FOLD, 0);
                 p.folded = true;
             }
+            logAction(t, roundNumber, p, logType, logAmount);
+            t.streetActions++;
             
-            // --- Stat Tracking ---
-            if (roundNumber == 0 && !p.isAI) {
-                if (voluntary) p.vpipActions++;
-                if (isRaise && !g_preFlopRaiseMade) {
-                    p.pfrActions++;
-                    g_preFlopRaiseMade = true;
+            // --- Per-seat opponent counters ---
+            SeatStats& st = t.seatStats;
+            if (threeBetSpot) { st.threeBetSpots[seat]++; if (isRaise) st.threeBets[seat]++; }
+            if (cbetSpot) { st.cbetSpots[seat]++; if (isRaise) st.cbets[seat]++; }
+            if (facingBet) { st.facedBet[seat]++; if (p.folded) st.foldedToBet[seat]++; }
+            if (isRaise) {
+                st.raises[seat]++;
+                t.lastAggressor = seat;
+                if (roundNumber == 0) {
+                    t.preflopRaises++;
+                    t.preflopAggressor = seat;
                 }
+            } else if (logType == HA_CALL) {
+                st.calls[seat]++;
+            }
+            
+            // --- Stat Tracking ---
+            if (roundNumber == 0 && (!p.isAI || t.selfPlay)) {
+                trackPreflopAction(voluntary, isRaise, t.preFlopRaiseMade, p.vpipActions, p.pfrActions);
             }
             
-            if (isRaise || (callAmt > 0 && action.find("CALL") != std::string::npos)) {
+            if (isRaise || (callAmt > 0 && action.kind == HA_CALL)) {
                 opened = true;
             }
         }
@@ -795,95 +4632,1225 @@ void bettingRound(int roundNumber) {
                 activeIn++;
             }
         }
-        
-        if (activeIn > 0 && finished && turn >= players.size()) break;
-        if (active <= 1) break;
+        
+        if (activeIn > 0 && finished && turn >= players.size()) break;
+        if (active <= 1) break;
+    }
+    
+    for (auto& p : players) {
+        p.currentBet = 0;
+    }
+    t.handRaises += t.streetRaises;
+}
+
+// ===== Check if Hand Over =====
+static std::string shownHandFrame(const Player& p) {
+    std::string f;
+    wireBegin(f, WF_SHOWDOWN);
+    wirePutName(f, p.name);
+    wirePutCards(f, p.hand);
+    wireEnd(f);
+    return f;
+}
+
+// hand is empty when the last player standing takes the pot.
+static std::string winFrame(int amount, const std::vector<Player*>& winners, const std::string& hand) {
+    std::string f;
+    wireBegin(f, WF_WIN);
+    wirePut32(f, (uint32_t)amount);
+    wirePut8(f, (uint8_t)winners.size());
+    for (const Player* w : winners) wirePutName(f, w->name);
+    f += hand;
+    wireEnd(f);
+    return f;
+}
+
+static std::string signalFrame(uint8_t type) {
+    std::string f;
+    wireBegin(f, type);
+    wireEnd(f);
+    return f;
+}
+
+bool checkIfHandOver(Table& t) {
+    int active = 0;
+    Player* winner = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(t.playersMutex);
+        for (auto& p : t.players) {
+            if (!p.folded && p.isConnected) {
+                active++;
+                winner = &p;
+            }
+        }
+    }
+    
+    if (active <= 1 && winner != nullptr) {
+        
+        // --- NEW: Display all hands on early end ---
+        broadcast(t, "\n--- SHOWING HANDS ---"); 
+        if (!t.headless) {
+            std::lock_guard<std::mutex> lock(t.playersMutex);
+            for (auto& p : t.players) {
+                if (p.isConnected && !p.hand.empty()) {
+                    std::string bcHand = p.name + "'s hand: " + handText(p.hand, false);
+                    std::string frame = shownHandFrame(p);
+                    broadcast_unsafe(t, bcHand, &frame); 
+                    std::string coutHand = p.name + "'s hand: " + handText(p.hand, true);
+                    {
+                        std::lock_guard<std::mutex> io(g_io_mutex);
+                        std::cout << coutHand << std::endl;
+                    }
+                }
+            }
+        }
+        // --- END NEW DISPLAY LOGIC ---
+
+        if (!t.headless) {
+            std::string msg = winner->name + " wins " + std::to_string(t.pot) + " (last standing)!";
+            std::string frame = winFrame(t.pot, {winner}, "");
+            broadcast(t, msg, &frame);
+            logLine(t, msg);
+        }
+        winner->chips += t.pot;
+        logSeatWin(t, *winner, t.pot);
+        return true;
+    }
+    return false;
+}
+
+// ===== Play One Hand =====
+static void playStreets(Table& t) {
+    // --- Ante ---
+    {
+        TraceSpan span("ante");
+        std::lock_guard<std::mutex> lock(t.playersMutex);
+        if (t.history) {
+            t.handLog.startMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            t.handLog.seats.resize(t.players.size());
+            t.handLog.actions.clear();
+            t.handLog.board.clear();
+            for (size_t i = 0; i < t.players.size(); ++i) {
+                HandLogSeat& s = t.handLog.seats[i];
+                s.name = t.players[i].name;
+                s.startStack = t.players[i].chips;
+                s.ante = 0;
+                s.isAI = t.players[i].isAI;
+                std::fill(std::begin(s.hole), std::end(s.hole), 0xFF);
+                s.won = 0;
+                s.showdown = false;
+            }
+        }
+        if (!t.headless) {
+            std::stringstream ss;
+            ss << "Collecting ante of " << t.ante;
+            {
+                std::lock_guard<std::mutex> io(g_io_mutex);
+                std::cout << ss.str() << std::endl;
+            }
+            broadcast_unsafe(t, ss.str());
+        }
+        for (auto& p : t.players) {
+            if (p.isConnected) {
+                int a = std::min(t.ante, p.chips);
+                p.chips -= a;
+                t.pot += a;
+                if (t.history) t.handLog.seats[&p - t.players.data()].ante = a;
+                if (p.chips == 0 && a > 0) {
+                    p.allIn = true;
+                    broadcast_unsafe(t, p.name + " is all-in from ante.");
+                }
+            }
+        }
+        if (!t.headless) {
+            std::stringstream ss;
+            ss << "Pot starts at " << t.pot;
+            {
+                std::lock_guard<std::mutex> io(g_io_mutex);
+                std::cout << ss.str() << std::endl;
+            }
+            broadcast_unsafe(t, ss.str());
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(t.playersMutex);
+        for (auto& p : t.players) p.handsPlayed++;
+    }
+    
+    std::string starting = signalFrame(WF_GAME_STARTING);
+    broadcast(t, "GAME_STARTING", &starting);
+    
+    // --- Deal Hole Cards ---
+    {
+        TraceSpan span("deal");
+        for (auto &p : t.players) {
+            if (p.hand.empty()) {
+                int holeCards = variantHoleCards(t.variant);
+                for (int k = 0; k < holeCards; ++k) p.hand.push_back(drawCard(t));
+                if (t.history) {
+                    HandLogSeat& s = t.handLog.seats[&p - t.players.data()];
+                    for (int k = 0; k < holeCards; ++k) s.hole[k] = cardCode(p.hand[k]);
+                }
+                if (!p.isAI) {
+                    std::string frame;
+                    wireBegin(frame, WF_HOLE);
+                    wirePutCards(frame, p.hand);
+                    wireEnd(frame);
+                    sendToPlayer(p, "HOLE " + handText(p.hand, false), &frame);
+                } else if (!t.headless) {
+                    std::lock_guard<std::mutex> lock(g_io_mutex);
+                    std::cout << "AI hole cards:\n" << displayCards(p.hand);
+                }
+            }
+        }
+    }
+    
+    // --- Betting Rounds ---
+    bettingRound(t, 0); // Pre-flop
+    if (checkIfHandOver(t)) return;
+    
+    for (int i = 0; i < 3; i++) t.communityCards.push_back(drawCard(t)); // Flop
+    logBoard(t);
+    for (size_t i = 0; i < t.players.size(); ++i) {
+        if (!t.players[i].folded && t.players[i].isConnected) t.seatStats.sawFlop[i]++;
+    }
+    showTable(t);
+    bettingRound(t, 1); // Post-flop
+    if (checkIfHandOver(t)) return;
+    
+    t.communityCards.push_back(drawCard(t)); // Turn
+    logBoard(t);
+    showTable(t);
+    bettingRound(t, 2); // Post-turn
+    if (checkIfHandOver(t)) return;
+    
+    t.communityCards.push_back(drawCard(t)); // River
+    logBoard(t);
+    showTable(t);
+    bettingRound(t, 3); // Post-river
+    if (checkIfHandOver(t)) return;
+
+    TraceSpan span("showdown");
+    broadcast(t, "\n--- SHOWDOWN ---");
+    logLine(t, "\n--- SHOWDOWN ---");
+    
+    // ===== UPDATED: SHOWDOWN LOGIC FOR SPLIT POTS =====
+    std::vector<Player*> winners;
+    HandResult bestHand = {0, "Nothing"};
+
+    {
+        std::lock_guard<std::mutex> lock(t.playersMutex);
+        for (auto& p : t.players) {
+            // --- NEW DISPLAY LOGIC ---
+            if (!t.headless && p.isConnected && !p.hand.empty()) {
+                std::string bcHand = p.name + "'s hand: " + handText(p.hand, false);
+                std::string frame = shownHandFrame(p);
+                broadcast_unsafe(t, bcHand, &frame);
+                
+                std::string coutHand = p.name + "'s hand: " + handText(p.hand, true);
+                {
+                    std::lock_guard<std::mutex> io(g_io_mutex);
+                    std::cout << coutHand << std::endl;
+                }
+            }
+
+            // --- WINNER EVALUATION LOGIC ---
+            // Now, separately, check if the player is eligible to win (NOT folded).
+            if (!p.folded && p.isConnected) {
+                logShowdown(t, p);
+                t.seatStats.showdowns[&p - t.players.data()]++;
+                HandResult hand = getShowdownHand(t, p);
+                
+                if (hand.rank > bestHand.rank) {
+                    bestHand = hand;
+                    winners.clear(); // New best hand, clear old winners
+                    winners.push_back(&p);
+                } else if (hand.rank == bestHand.rank && bestHand.rank > 0) {
+                    winners.push_back(&p); // Tied for best hand
+                }
+            }
+        }
+    }
+
+    if (!winners.empty()) {
+        std::string msg;
+        if (winners.size() == 1) {
+            // Single winner
+            Player* winner = winners[0];
+            if (!t.headless) msg = winner->name + " wins " + std::to_string(t.pot) + " with " + bestHand.name + "!";
+            winner->chips += t.pot;
+            logSeatWin(t, *winner, t.pot);
+        } else {
+            // Split pot
+            int splitAmount = t.pot / winners.size();
+            int remainder = t.pot % winners.size();
+            std::string winnerNames;
+            for (size_t i = 0; i < winners.size(); ++i) {
+                winnerNames += winners[i]->name;
+                if (i < winners.size() - 1) winnerNames += ", ";
+                winners[i]->chips += splitAmount;
+                logSeatWin(t, *winners[i], splitAmount + (i == 0 ? remainder : 0));
+            }
+            winners[0]->chips += remainder; 
+            if (!t.headless) msg = "Split pot! " + std::to_string(t.pot) + " split between: " + winnerNames + " with " + bestHand.name;
+        }
+        std::string frame;
+        if (!t.headless) frame = winFrame(t.pot, winners, bestHand.name);
+        broadcast(t, msg, &frame);
+        logLine(t, msg);
+    } else {
+        std::string msg = "No winner, pot returned (NI).";
+        broadcast(t, msg);
+        logLine(t, msg);
+    }
+    // ===== END UPDATED SHOWDOWN LOGIC =====
+}
+
+// Ante, deal, four betting rounds and showdown. The caller resets the table
+// first and decides whether another hand follows.
+void playHand(Table& t) {
+    TraceSpan span("hand", "table", (int)t.id);
+    t.handInProgress = true;
+    playStreets(t);
+    t.handInProgress = false;
+    if (t.history) t.history->submit(t.handLog);
+    if (t.models) {
+        for (const auto& p : t.players) {
+            if (!p.isAI || t.selfPlay) t.models->save(p);
+        }
+    }
+}
+
+// ===== Self-Play Simulator =====
+// Headless AI-vs-AI tables for tuning. Tables are independent and seeded from
+// (seed, table index), so a run is reproducible whatever the thread count.
+// Tables run as root jobs on the shared scheduler, and their Monte Carlo
+// chunks fill the remaining workers.
+struct SimOptions {
+    int tables = SIM_DEFAULT_TABLES;
+    int handsPerTable = SIM_DEFAULT_HANDS;
+    int seats = 2;
+    int threads = 0; // 0 = all cores
+    int trials = SIM_DEFAULT_TRIALS;
+    unsigned seed = 1;
+    std::vector<AIProfile> profiles{AIProfile()};
+    EquitySampling sampling = EquitySampling::Random;
+    GameVariant variant = GameVariant::Holdem;
+    std::string blueprintPath;
+    std::string tracePath;
+    HandHistoryWriter* history = nullptr;
+};
+
+struct SimResult {
+    long long hands = 0;
+    std::vector<long long> seatNet; // Chips won (+) or lost (-) per seat
+    AIStats aiStats;
+};
+
+// Plays one table to completion. Every hand starts from STARTING_CHIPS so
+// hands are independent samples and no seat ever busts out.
+SimResult simulateTable(const SimOptions& opt, int tableIndex) {
+    Table t;
+    t.headless = true;
+    t.selfPlay = true;
+    t.simulations = opt.trials;
+    t.sampling = opt.sampling;
+    t.variant = opt.variant;
+    t.decisionBudgetMs = SIM_DECISION_BUDGET_MS;
+    t.history = opt.history;
+    // The deal has its own stream: runs with the same seed see the same cards
+    // whatever the AIs decide, so styles are compared on common hands.
+    t.seed = deriveKey(opt.seed, (uint64_t)tableIndex);
+
+    for (int s = 0; s < opt.seats; ++s) {
+        Player ai;
+        ai.name = "Bot" + std::to_string(s + 1);
+        ai.isAI = true;
+        ai.profile = opt.profiles[s % opt.profiles.size()];
+        t.players.push_back(ai);
+    }
+
+    SimResult res;
+    res.seatNet.assign(opt.seats, 0);
+    for (int h = 0; h < opt.handsPerTable; ++h) {
+        for (auto& p : t.players) p.chips = t.startingChips;
+        resetForNextHand(t);
+        playHand(t);
+        for (int s = 0; s < opt.seats; ++s) {
+            res.seatNet[s] += t.players[s].chips - t.startingChips;
+        }
+        res.hands++;
+    }
+    res.aiStats = t.aiStats;
+    return res;
+}
+
+static double ratio(long long num, long long den) {
+    return den > 0 ? (double)num / (double)den : 0.0;
+}
+
+int runSimulation(const SimOptions& opt) {
+    if (!opt.blueprintPath.empty() && !loadBlueprint(opt.blueprintPath, ANTE_AMOUNT, STARTING_CHIPS)) return 1;
+    g_scheduler.start(opt.threads);
+    int threads = g_scheduler.threads();
+
+    std::cout << "Simulating " << opt.tables << " tables x " << opt.handsPerTable << " "
+              << VARIANT_NAMES[(int)opt.variant] << " hands, " << opt.seats << " seats, " << opt.trials << " " << SAMPLING_NAMES[(int)opt.sampling] << " trials/decision, "
+              << threads << " threads, seed " << opt.seed << std::endl;
+
+    std::vector<SimResult> results(opt.tables);
+    auto start = std::chrono::steady_clock::now();
+
+    TaskGroup group;
+    auto deadline = start + std::chrono::milliseconds(SIM_DECISION_BUDGET_MS);
+    for (int i = 0; i < opt.tables; ++i) {
+        g_scheduler.submit([&, i]() { results[i] = simulateTable(opt, i); }, deadline, &group, false);
+    }
+    group.wait();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SimResult total;
+    total.seatNet.assign(opt.seats, 0);
+    for (const auto& r : results) {
+        total.hands += r.hands;
+        for (int s = 0; s < opt.seats; ++s) total.seatNet[s] += r.seatNet[s];
+        total.aiStats.merge(r.aiStats);
+    }
+
+    const AIStats& a = total.aiStats;
+    printf("Hands: %lld in %.2fs (%.0f hands/sec)\n", total.hands, secs, secs > 0 ? total.hands / secs : 0.0);
+    printf("Chip EV per seat (chips/hand):\n");
+    for (int s = 0; s < opt.seats; ++s) {
+        printf("  Seat %d (%s): %+.3f\n", s + 1, opt.profiles[s % opt.profiles.size()].name,
+               ratio(total.seatNet[s], total.hands));
+    }
+    printf("AI decisions: %lld\n", a.decisions);
+    printf("  Bluff bets:        %.2f%% of %lld spots\n", 100.0 * ratio(a.bluffs, a.bluffSpots), a.bluffSpots);
+    printf("  Semi-bluff raises: %.2f%% of %lld spots\n", 100.0 * ratio(a.semiBluffs, a.semiBluffSpots), a.semiBluffSpots);
+    printf("  Folds to a bet:    %.2f%% of %lld spots\n", 100.0 * ratio(a.folds, a.facingBet), a.facingBet);
+    printf("  Value bets: %lld, value raises: %lld\n", a.valueBets, a.valueRaises);
+    if (a.blueprint > 0) printf("  From the blueprint: %lld\n", a.blueprint);
+    if (!opt.tracePath.empty()) {
+        fflush(stdout);
+        dumpTrace(opt.tracePath);
+    }
+    return 0;
+}
+
+static bool parseSimOptions(int argc, char* argv[], SimOptions& opt, std::string& historyPath) {
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << a << std::endl;
+            return false;
+        }
+        if (a == "--history") {
+            historyPath = argv[++i];
+            continue;
+        }
+        if (a == "--blueprint") {
+            opt.blueprintPath = argv[++i];
+            continue;
+        }
+        if (a == "--trace") {
+            opt.tracePath = argv[++i];
+            g_traceEnabled = true;
+            continue;
+        }
+        if (a == "--profiles") {
+            if (!parseAIProfiles(argv[++i], opt.profiles)) {
+                std::cerr << "Bad profile list " << argv[i] << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (a == "--sampling") {
+            if (!parseSampling(argv[++i], opt.sampling)) {
+                std::cerr << "Unknown sampling " << argv[i] << " (random, stratified, quasi)" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (a == "--variant") {
+            if (!parseVariant(argv[++i], opt.variant)) {
+                std::cerr << "Unknown variant " << argv[i] << " (holdem, omaha, shortdeck)" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        long v = std::strtol(argv[++i], nullptr, 10);
+        if (a == "--tables") opt.tables = (int)v;
+        else if (a == "--hands") opt.handsPerTable = (int)v;
+        else if (a == "--seats") opt.seats = (int)v;
+        else if (a == "--threads") opt.threads = (int)v;
+        else if (a == "--trials") opt.trials = (int)v;
+        else if (a == "--seed") opt.seed = (unsigned)v;
+        else {
+            std::cerr << "Unknown option " << a << std::endl;
+            return false;
+        }
+    }
+    if (opt.tables < 1 || opt.handsPerTable < 1 || opt.trials < 1 ||
+        opt.seats < 2 || opt.seats > MAX_SEATS) {
+        std::cerr << "Need tables >= 1, hands >= 1, trials >= 1 and 2-" << MAX_SEATS << " seats." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// ===== Equity Check =====
+// `--check-equity` measures each sampling mode against exact enumeration on a
+// fixed set of post-flop spots (pre-flop enumeration is too slow for a quick
+// check). Every mode is run many times at the same trial count; the report
+// shows the real error against the exact value, the standard error the
+// estimator claimed, and how many random-sampling trials give the same error.
+struct EquitySpot {
+    const char* hole;
+    const char* board;
+};
+
+static const EquitySpot EQUITY_SPOTS[] = {
+    {"AhKh", "Qh7d2c"},   // Overcards and a backdoor flush
+    {"7d2c", "AsKsQs"},   // Air on a monotone board
+    {"JcTc", "9c8h2d"},   // Open-ended straight and flush draw
+    {"8s8d", "Ah9c4d7s"}, // Underpair on the turn
+    {"QdJd", "Td9s3c2h"}, // Open-ended draw on the turn
+};
+
+// Parses cards written like "AhTd" into codes.
+static bool parseCardCodes(const char* text, std::vector<uint8_t>& out) {
+    static const char ranks[] = "23456789TJQKA";
+    static const char suits[] = "hdcs"; // getFullDeck() suit order
+    for (const char* c = text; *c; c += 2) {
+        const char* r = std::strchr(ranks, c[0]);
+        const char* s = c[1] ? std::strchr(suits, c[1]) : nullptr;
+        if (!r || !s || !c[0] || !c[1]) return false;
+        out.push_back((uint8_t)((s - suits) * 13 + (r - ranks)));
+    }
+    return true;
+}
+
+static EquityBatch spotBatch(const std::vector<uint8_t>& hole, const std::vector<uint8_t>& board, EquitySampling sampling) {
+    EquityBatch b;
+    b.sampling = sampling;
+    for (uint8_t c : board) b.board |= cardBit(c);
+    b.boardCards = board.size();
+    for (uint8_t code = 0; code < 52; ++code) {
+        if (!(b.board & cardBit(code))) b.unseen.push_back(code);
+    }
+    b.hole = hole;
+    if (sampling != EquitySampling::Random) buildOpponentCombos(b, {});
+    return b;
+}
+
+// Exact equity against a random hand: every opponent hand with every runout.
+static double exactEquity(const EquityBatch& b) {
+    uint8_t h0 = b.hole[0], h1 = b.hole[1];
+    std::vector<uint8_t> deck;
+    for (uint8_t c : b.unseen) {
+        if (c != h0 && c != h1) deck.push_back(c);
+    }
+    std::vector<uint64_t> runouts;
+    size_t toDeal = 5 - b.boardCards;
+    std::function<void(size_t, size_t, uint64_t)> extend = [&](size_t from, size_t left, uint64_t m) {
+        if (left == 0) {
+            runouts.push_back(m);
+            return;
+        }
+        for (size_t i = from; i < deck.size(); ++i) extend(i + 1, left - 1, m | cardBit(deck[i]));
+    };
+    extend(0, toDeal, b.board);
+
+    std::vector<uint64_t> hands(runouts.size());
+    std::vector<long long> bot(runouts.size()), opp(runouts.size());
+    for (size_t r = 0; r < runouts.size(); ++r) hands[r] = runouts[r] | cardBit(h0) | cardBit(h1);
+    rankHands(hands.data(), hands.size(), bot.data());
+
+    double score = 0;
+    long long total = 0;
+    for (size_t i = 0; i < deck.size(); ++i) {
+        for (size_t j = i + 1; j < deck.size(); ++j) {
+            uint64_t oppHole = cardBit(deck[i]) | cardBit(deck[j]);
+            size_t n = 0;
+            for (size_t r = 0; r < runouts.size(); ++r) {
+                if (!(runouts[r] & oppHole)) hands[n++] = runouts[r] | oppHole;
+            }
+            rankHands(hands.data(), n, opp.data());
+            n = 0;
+            for (size_t r = 0; r < runouts.size(); ++r) {
+                if (runouts[r] & oppHole) continue;
+                if (bot[r] > opp[n]) score += 1;
+                else if (bot[r] == opp[n]) score += 0.5;
+                n++;
+                total++;
+            }
+        }
+    }
+    return score / total;
+}
+
+struct CheckOptions {
+    int trials = 500;
+    int runs = 200;
+    int threads = 0;
+    unsigned seed = 1;
+};
+
+int checkEquity(const CheckOptions& opt) {
+    g_scheduler.start(opt.threads);
+    CounterRng rng(deriveKey(opt.seed, 0));
+    printf("%d trials per estimate, %d estimates per mode\n", opt.trials, opt.runs);
+    for (const auto& spot : EQUITY_SPOTS) {
+        std::vector<uint8_t> hole, board;
+        parseCardCodes(spot.hole, hole);
+        parseCardCodes(spot.board, board);
+        double exact = exactEquity(spotBatch(hole, board, EquitySampling::Random));
+        printf("%s on %s: exact %.4f\n", spot.hole, spot.board, exact);
+        double randomMse = 0;
+        for (int m = 0; m < 3; ++m) {
+            EquityBatch b = spotBatch(hole, board, static_cast<EquitySampling>(m));
+            double sq = 0, claimed = 0, mean = 0;
+            for (int r = 0; r < opt.runs; ++r) {
+                EquityEstimate e = estimateEquity(b, opt.trials, rng, SIM_DECISION_BUDGET_MS)[0];
+                sq += (e.equity - exact) * (e.equity - exact);
+                claimed += e.stdError;
+                mean += e.equity;
+            }
+            double mse = sq / opt.runs;
+            if (m == 0) randomMse = mse;
+            printf("  %-10s mean %.4f  rms error %.4f  reported se %.4f  = %.0f random trials\n",
+                   SAMPLING_NAMES[m], mean / opt.runs, std::sqrt(mse), claimed / opt.runs,
+                   mse > 0 ? opt.trials * randomMse / mse : 0.0);
+        }
+    }
+    return 0;
+}
+
+static bool parseCheckOptions(int argc, char* argv[], CheckOptions& opt) {
+    for (int i = 2; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << a << std::endl;
+            return false;
+        }
+        long v = std::strtol(argv[++i], nullptr, 10);
+        if (a == "--trials") opt.trials = (int)v;
+        else if (a == "--runs") opt.runs = (int)v;
+        else if (a == "--threads") opt.threads = (int)v;
+        else if (a == "--seed") opt.seed = (unsigned)v;
+        else {
+            std::cerr << "Unknown option " << a << std::endl;
+            return false;
+        }
+    }
+    return opt.trials >= 1 && opt.runs >= 1;
+}
+
+// ===== Blueprint Solver =====
+// `--solve FILE` runs chance-sampled CFR+ on the blueprint abstraction and
+// writes the average strategy. Each iteration deals two hands and a board,
+// then walks the full betting tree once for each player, updating that
+// player's regrets (floored at zero) and adding their current strategy to the
+// average with weight equal to the iteration number. Deals are dealt and
+// bucketed in batches on the scheduler, seeded by their position in the run,
+// so the file is the same whatever the thread count.
+struct SolveOptions {
+    long long iterations = BLUEPRINT_ITERATIONS;
+    int threads = 0; // 0 = all cores
+    unsigned seed = 1;
+    int ante = ANTE_AMOUNT;
+    int stack = STARTING_CHIPS; // --chips, as for the server
+};
+
+struct SolverDeal {
+    uint8_t bucket[2][BP_STREETS];
+    int8_t showdown; // +1 seat 0 wins, -1 seat 1 wins, 0 split
+};
+
+struct SolverState {
+    int street = 0;
+    int potClass = 0;
+    int raisesBefore = 0;
+    int contrib[2] = {0, 0}; // Chips in the pot, antes included
+    int bet[2] = {0, 0};                         // This street
+    int raises = 0, acted = 0, toAct = 0;
+};
+
+static void dealSolverHands(SolverDeal* out, size_t n, unsigned seed, long long first) {
+    CounterRng rng(deriveKey(seed, first));
+    uint8_t deck[52];
+    for (size_t i = 0; i < n; ++i) {
+        for (uint8_t c = 0; c < 52; ++c) deck[c] = c;
+        for (int k = 0; k < 9; ++k) std::swap(deck[k], deck[k + rng.below(52 - k)]);
+        uint64_t board = 0;
+        double strength[2];
+        for (int street = 0; street < BP_STREETS; ++street) {
+            if (street > 0) {
+                for (int k = street == 1 ? 4 : street + 5; k < street + 6; ++k) board |= cardBit(deck[k]);
+            }
+            handStrengths(board, street == 0 ? 0 : street + 2, deck, 2, rng.next64(), strength);
+            for (int p = 0; p < 2; ++p) out[i].bucket[p][street] = (uint8_t)strengthBucket(strength[p]);
+        }
+        long long r0 = rankHand(board | cardBit(deck[0]) | cardBit(deck[1]));
+        long long r1 = rankHand(board | cardBit(deck[2]) | cardBit(deck[3]));
+        out[i].showdown = (int8_t)((r0 > r1) - (r0 < r1));
+    }
+}
+
+class BlueprintSolver {
+public:
+    BlueprintSolver(int ante, int stack)
+        : m_regret(BP_POINTS * BP_ACTIONS), m_average(BP_POINTS * BP_ACTIONS), m_ante(ante), m_stack(stack) {}
+
+    void iterate(const SolverDeal& d, double weight) {
+        SolverState root;
+        root.contrib[0] = root.contrib[1] = m_ante;
+        for (int player = 0; player < 2; ++player) walk(d, root, player, 1.0, 1.0, weight);
+    }
+
+    // Average strategy, quantized to bytes summing to 255 (all zero if never reached).
+    std::vector<uint8_t> quantize() const {
+        std::vector<uint8_t> out(BP_POINTS * BP_ACTIONS);
+        for (size_t i = 0; i < BP_POINTS; ++i) {
+            const double* a = &m_average[i * BP_ACTIONS];
+            double sum = a[0] + a[1] + a[2];
+            if (sum <= 0) continue;
+            uint8_t* q = &out[i * BP_ACTIONS];
+            int total = 0, top = 0;
+            for (int k = 0; k < BP_ACTIONS; ++k) {
+                q[k] = (uint8_t)std::lround(255.0 * a[k] / sum);
+                total += q[k];
+                if (a[k] > a[top]) top = k;
+            }
+            q[top] = (uint8_t)(q[top] + 255 - total);
+        }
+        return out;
+    }
+
+private:
+    // Value of state s to 'player'; reachSelf/reachOpp are the players' own
+    // probabilities of playing to s.
+    double walk(const SolverDeal& d, const SolverState& s, int player, double reachSelf, double reachOpp, double weight) {
+        int me = s.toAct, opp = 1 - me;
+        int callAmt = s.bet[opp] - s.bet[me];
+        int left = m_stack - s.contrib[me];
+        bool legal[BP_ACTIONS] = {callAmt > 0, true,
+                                  s.raises < BLUEPRINT_RAISE_CAP && left > callAmt && s.contrib[opp] < m_stack};
+        size_t point = blueprintIndex(s.street, s.potClass, blueprintNode(callAmt, s.raises, s.acted), me, d.bucket[me][s.street]);
+        double* regret = &m_regret[point * BP_ACTIONS];
+
+        double sigma[BP_ACTIONS] = {0, 0, 0}, positive = 0;
+        int legalCount = 0;
+        for (int a = 0; a < BP_ACTIONS; ++a) {
+            if (!legal[a]) continue;
+            positive += regret[a];
+            legalCount++;
+        }
+        for (int a = 0; a < BP_ACTIONS; ++a) {
+            if (legal[a]) sigma[a] = positive > 0 ? regret[a] / positive : 1.0 / legalCount;
+        }
+
+        double value[BP_ACTIONS] = {0, 0, 0}, nodeValue = 0;
+        for (int a = 0; a < BP_ACTIONS; ++a) {
+            if (!legal[a] || (me != player && sigma[a] == 0)) continue;
+            double rs = me == player ? reachSelf * sigma[a] : reachSelf;
+            double ro = me == player ? reachOpp : reachOpp * sigma[a];
+            value[a] = act(d, s, a, player, rs, ro, weight);
+            nodeValue += sigma[a] * value[a];
+        }
+        if (me == player) {
+            double* average = &m_average[point * BP_ACTIONS];
+            for (int a = 0; a < BP_ACTIONS; ++a) {
+                if (!legal[a]) continue;
+                regret[a] = std::max(0.0, regret[a] + reachOpp * (value[a] - nodeValue));
+                average[a] += weight * reachSelf * sigma[a];
+            }
+        }
+        return nodeValue;
     }
-    
-    for (auto& p : players) {
-        p.currentBet = 0;
+
+    double act(const SolverDeal& d, SolverState s, int a, int player, double reachSelf, double reachOpp, double weight) {
+        int me = s.toAct, opp = 1 - me;
+        int callAmt = s.bet[opp] - s.bet[me];
+        int left = m_stack - s.contrib[me];
+        if (a == BP_FOLD) return me == player ? -s.contrib[me] : s.contrib[me];
+        int putIn = std::min(callAmt, left);
+        if (a == BP_RAISE) {
+            int total = s.bet[opp] + aiRaiseAmount(callAmt, s.contrib[0] + s.contrib[1]);
+            putIn = std::min(total - s.bet[me], left);
+            s.raises++;
+        }
+        s.bet[me] += putIn;
+        s.contrib[me] += putIn;
+        s.acted++;
+        s.toAct = opp;
+        if (s.acted < 2 || s.bet[0] != s.bet[1]) return walk(d, s, player, reachSelf, reachOpp, weight);
+
+        if (s.street == BP_STREETS - 1 || s.contrib[0] == m_stack || s.contrib[1] == m_stack) {
+            int won = d.showdown * std::min(s.contrib[0], s.contrib[1]);
+            return player == 0 ? won : -won;
+        }
+        s.street++;
+        s.raisesBefore += s.raises;
+        s.potClass = std::min(s.raisesBefore, BP_POT_CLASSES - 1);
+        s.bet[0] = s.bet[1] = 0;
+        s.raises = s.acted = s.toAct = 0;
+        return walk(d, s, player, reachSelf, reachOpp, weight);
+    }
+
+    std::vector<double> m_regret;
+    std::vector<double> m_average;
+    int m_ante, m_stack;
+};
+
+int solveBlueprint(const std::string& path, const SolveOptions& opt) {
+    g_scheduler.start(opt.threads);
+    printf("Solving %lld iterations, %d buckets, ante %d, %d chips, %d threads, seed %u\n", opt.iterations,
+           BLUEPRINT_BUCKETS, opt.ante, opt.stack, g_scheduler.threads(), opt.seed);
+    rangeTables();
+
+    BlueprintSolver solver(opt.ante, opt.stack);
+    std::vector<SolverDeal> deals(BLUEPRINT_DEAL_BATCH);
+    const size_t chunk = 256;
+    auto start = std::chrono::steady_clock::now();
+    long long nextReport = opt.iterations / 10;
+    for (long long done = 0; done < opt.iterations;) {
+        size_t n = (size_t)std::min<long long>(BLUEPRINT_DEAL_BATCH, opt.iterations - done);
+        TaskGroup group;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SIM_DECISION_BUDGET_MS);
+        for (size_t i = 0; i < n; i += chunk) {
+            size_t len = std::min(chunk, n - i);
+            g_scheduler.submit([&, i, len]() { dealSolverHands(&deals[i], len, opt.seed, done + (long long)i); },
+                               deadline, &group, false);
+        }
+        group.wait();
+        for (size_t i = 0; i < n; ++i) solver.iterate(deals[i], (double)(done + (long long)i + 1));
+        done += n;
+        if (done >= nextReport || done == opt.iterations) {
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("  %lld iterations, %.1fs\n", done, secs);
+            nextReport += std::max(1LL, opt.iterations / 10);
+        }
+    }
+
+    std::vector<uint8_t> strategy = solver.quantize();
+    BlueprintHeader h{};
+    std::memcpy(h.magic, BLUEPRINT_MAGIC, 8);
+    h.version = BLUEPRINT_VERSION;
+    h.checksum = hhChecksum(strategy.data(), strategy.size());
+    h.iterations = (uint64_t)opt.iterations;
+    h.streets = BP_STREETS;
+    h.potClasses = BP_POT_CLASSES;
+    h.nodes = BP_NODES;
+    h.buckets = BLUEPRINT_BUCKETS;
+    h.positions = BP_POSITIONS;
+    h.ante = (uint32_t)opt.ante;
+    h.stack = (uint32_t)opt.stack;
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    bool ok = f && std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+              std::fwrite(strategy.data(), 1, strategy.size(), f) == strategy.size();
+    if (f && std::fclose(f) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return 1;
     }
+    size_t reached = 0;
+    for (size_t i = 0; i < BP_POINTS; ++i) reached += (strategy[i * BP_ACTIONS] | strategy[i * BP_ACTIONS + 1] | strategy[i * BP_ACTIONS + 2]) != 0;
+    printf("Wrote %s: %zu of %zu decision points reached, %zu bytes\n", path.c_str(), reached, BP_POINTS,
+           sizeof(h) + strategy.size());
+    return 0;
 }
 
-// ===== Client Handler =====
-void clientHandler(socket_t sock) {
-    char buf[1024];
-    std::string netBuf = "";
-    try {
-        while (true) {
-            int vr = READSOCK(sock, buf, 1023);
-            if (vr <= 0) {
-                std::lock_guard<std::mutex> lock(g_inbound_mutex);
-                g_inbound_messages.push({sock, "DISCONNECTED"});
-                break;
-            }
-            buf[vr] = '\0';
-            netBuf += buf;
-            
-            size_t pos;
-            while ((pos = netBuf.find('\n')) != std::string::npos) {
-                std::string msg = netBuf.substr(0, pos);
-                netBuf.erase(0, pos + 1);
-                msg.erase(std::remove(msg.begin(), msg.end(), '\r'), msg.end());
-                
-                std::lock_guard<std::mutex> lock(g_inbound_mutex);
-                g_inbound_messages.push({sock, msg});
-            }
+static bool parseSolveOptions(int argc, char* argv[], SolveOptions& opt) {
+    for (int i = 3; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << a << std::endl;
+            return false;
+        }
+        long long v = std::strtoll(argv[++i], nullptr, 10);
+        if (a == "--iterations") opt.iterations = v;
+        else if (a == "--threads") opt.threads = (int)v;
+        else if (a == "--seed") opt.seed = (unsigned)v;
+        else if (a == "--ante") opt.ante = (int)v;
+        else if (a == "--chips") opt.stack = (int)v;
+        else {
+            std::cerr << "Unknown option " << a << std::endl;
+            return false;
         }
-    } catch (const std::exception& e) {
-        std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cerr << "Ex clientHandler:" << e.what() << std::endl;
     }
-    CLOSESOCK(sock);
+    return opt.iterations >= 1 && opt.ante >= 1 && opt.stack > opt.ante;
 }
 
-// ===== Check if Hand Over =====
-bool checkIfHandOver() {
-    int active = 0;
-    Player* winner = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(g_players_mutex);
-        for (auto& p : players) {
-            if (!p.folded && p.isConnected) {
-                active++;
-                winner = &p;
-            }
+// ===== Hand-History Analyzer =====
+// Offline statistics over a hand-history file. The mapped file is split at
+// index blocks and worker threads claim chunks one at a time, so memory use
+// stays flat however many hands the file holds. Each worker tallies into its
+// own totals and the results are merged at the end.
+struct PlayerTotals {
+    long long hands = 0;
+    long long vpipActions = 0, pfrActions = 0; // Counted as bettingRound() does
+    long long raises = 0, calls = 0;
+    long long sawFlop = 0, showdowns = 0, showdownWins = 0;
+    long long net = 0;
+
+    void merge(const PlayerTotals& o) {
+        hands += o.hands;
+        vpipActions += o.vpipActions; pfrActions += o.pfrActions;
+        raises += o.raises; calls += o.calls;
+        sawFlop += o.sawFlop; showdowns += o.showdowns; showdownWins += o.showdownWins;
+        net += o.net;
+    }
+};
+
+struct SituationTotals {
+    long long hands = 0, wins = 0, net = 0;
+    void add(int seatNet) { hands++; if (seatNet > 0) wins++; net += seatNet; }
+    void merge(const SituationTotals& o) { hands += o.hands; wins += o.wins; net += o.net; }
+};
+
+enum EndStreet { END_PREFLOP, END_FLOP, END_TURN, END_RIVER, END_SHOWDOWN, END_COUNT };
+enum FlopClass { FLOP_MADE, FLOP_FLUSH_DRAW, FLOP_OESD, FLOP_GUTSHOT, FLOP_NOTHING, FLOP_COUNT };
+
+struct AnalyzerTotals {
+    long long hands = 0;
+    std::unordered_map<std::string, PlayerTotals> players;
+    SituationTotals aiByEnd[END_COUNT];
+    SituationTotals aiByFlop[FLOP_COUNT];
+
+    void merge(const AnalyzerTotals& o) {
+        hands += o.hands;
+        for (const auto& [name, p] : o.players) players[name].merge(p);
+        for (int i = 0; i < END_COUNT; ++i) aiByEnd[i].merge(o.aiByEnd[i]);
+        for (int i = 0; i < FLOP_COUNT; ++i) aiByFlop[i].merge(o.aiByFlop[i]);
+    }
+};
+
+// The AI's holding on the flop, classified with the showdown evaluator and
+// the same draw detection AIAction() uses.
+static FlopClass classifyFlop(const HandLogSeat& s, const std::vector<uint8_t>& board) {
+    Player p;
+    p.hand = {cardFromCode(s.hole[0]), cardFromCode(s.hole[1])};
+    CardList flop;
+    for (int i = 0; i < 3; ++i) flop.push_back(cardFromCode(board[i]));
+    if (getFullPlayerHand(p, flop).rank >= static_cast<long long>(1e12)) return FLOP_MADE;
+
+    std::vector<Card> all(p.hand.begin(), p.hand.end());
+    all.insert(all.end(), flop.begin(), flop.end());
+    DrawInfo d = detectDraws(all);
+    if (d.flushDraw) return FLOP_FLUSH_DRAW;
+    if (d.oesd) return FLOP_OESD;
+    if (d.gutshot) return FLOP_GUTSHOT;
+    return FLOP_NOTHING;
+}
+
+static void tallyHand(const HandLog& log, AnalyzerTotals& a) {
+    size_t n = log.seats.size();
+    int net[MAX_SEATS] = {};
+    bool foldedPreflop[MAX_SEATS] = {};
+    if (n > MAX_SEATS) return;
+
+    a.hands++;
+    bool raiseMade = false;
+    for (size_t i = 0; i < n; ++i) {
+        net[i] = log.seats[i].won - log.seats[i].ante;
+        a.players[log.seats[i].name].hands++;
+    }
+    for (const auto& act : log.actions) {
+        if (act.seat >= n) continue;
+        PlayerTotals& pt = a.players[log.seats[act.seat].name];
+        net[act.seat] -= act.amount;
+        if (act.street == 0) {
+            trackPreflopAction(act.type == HA_CALL || act.type == HA_RAISE, act.type == HA_RAISE,
+                               raiseMade, pt.vpipActions, pt.pfrActions);
+            if (act.type == HA_FOLD) foldedPreflop[act.seat] = true;
         }
+        if (act.type == HA_RAISE) pt.raises++;
+        else if (act.type == HA_CALL) pt.calls++;
     }
-    
-    if (active <= 1 && winner != nullptr) {
-        
-        // --- NEW: Display all hands on early end ---
-        broadcast("\n--- SHOWING HANDS ---"); 
-        {
-            std::lock_guard<std::mutex> lock(g_players_mutex);
-            for (auto& p : players) {
-                if (p.isConnected && !p.hand.empty()) {
-                    std::string bcHand = p.name + "'s hand: " + p.hand[0].toString() + " " + p.hand[1].toString();
-                    broadcast_unsafe(bcHand); 
-                    std::string coutHand = p.name + "'s hand: " + p.hand[0].rank + p.hand[0].suit + " " + p.hand[1].rank + p.hand[1].suit;
-                    {
-                        std::lock_guard<std::mutex> io(g_io_mutex);
-                        std::cout << coutHand << std::endl;
-                    }
+
+    bool showdown = false;
+    for (const auto& s : log.seats) showdown = showdown || s.showdown;
+    int end = showdown ? END_SHOWDOWN : (log.board.empty() ? END_PREFLOP : (int)log.board.size() - 2);
+
+    for (size_t i = 0; i < n; ++i) {
+        const HandLogSeat& s = log.seats[i];
+        PlayerTotals& pt = a.players[s.name];
+        pt.net += net[i];
+        bool sawFlop = log.board.size() >= 3 && !foldedPreflop[i];
+        if (sawFlop) pt.sawFlop++;
+        if (s.showdown) {
+            pt.showdowns++;
+            if (s.won > 0) pt.showdownWins++;
+        }
+        if (s.isAI) {
+            a.aiByEnd[end].add(net[i]);
+            if (sawFlop && s.hole[0] < 52 && s.hole[1] < 52 && s.hole[2] == 0xFF) a.aiByFlop[classifyFlop(s, log.board)].add(net[i]);
+        }
+    }
+}
+
+struct AnalyzeOptions {
+    std::string path;
+    long long lastHands = 0; // 0 = whole file
+    int threads = 0;
+    int top = 20;
+};
+
+int analyzeHandHistory(const AnalyzeOptions& opt) {
+    HandHistoryReader reader;
+    if (!reader.open(opt.path)) {
+        std::cerr << "Cannot open hand history " << opt.path << std::endl;
+        return 1;
+    }
+    std::vector<HandHistoryReader::Chunk> chunks = reader.chunks();
+
+    // For --last, keep whole chunks from the end and skip into the first one.
+    size_t firstChunk = 0;
+    long long skipInFirst = 0;
+    if (opt.lastHands > 0) {
+        long long kept = 0;
+        firstChunk = chunks.size();
+        while (firstChunk > 0 && kept < opt.lastHands) kept += chunks[--firstChunk].hands;
+        skipInFirst = std::max(0LL, kept - opt.lastHands);
+    }
+
+    int threads = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    std::vector<AnalyzerTotals> partial(threads);
+    std::atomic<size_t> nextChunk{firstChunk};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threads; ++w) {
+        workers.emplace_back([&, w]() {
+            HandRecord rec;
+            size_t c;
+            while ((c = nextChunk.fetch_add(1)) < chunks.size()) {
+                size_t pos = chunks[c].begin;
+                long long skip = (c == firstChunk) ? skipInFirst : 0;
+                while (reader.nextAt(pos, chunks[c].end, rec)) {
+                    if (skip > 0) { skip--; continue; }
+                    tallyHand(rec.log, partial[w]);
                 }
             }
-        }
-        // --- END NEW DISPLAY LOGIC ---
+        });
+    }
+    for (auto& w : workers) w.join();
 
-        std::string msg = winner->name + " wins " + std::to_string(pot) + " (last standing)!";
-        broadcast(msg);
-        {
-            std::lock_guard<std::mutex> lock(g_io_mutex);
-            std::cout << msg << std::endl;
+    AnalyzerTotals total;
+    for (const auto& p : partial) total.merge(p);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Analyzed %lld hands in %.2fs using %d threads\n\n", total.hands, secs, threads);
+
+    std::vector<std::pair<std::string, PlayerTotals>> rows(total.players.begin(), total.players.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second.hands > b.second.hands; });
+    if ((int)rows.size() > opt.top) rows.resize(opt.top);
+
+    printf("%-17s %9s %6s %6s %6s %6s %6s %9s  %s\n", "Player", "Hands", "VPIP", "PFR", "AF", "WTSD", "W$SD", "Chips/hd", "Read");
+    for (const auto& [name, p] : rows) {
+        OpponentRead r;
+        std::string read = "-";
+        if (readOpponent(p.hands, p.vpipActions, p.pfrActions, r)) {
+            read = std::string(r.tight ? "Tight" : "Loose") + "/" + (r.aggressive ? "Aggressive" : "Passive");
         }
-        winner->chips += pot;
+        printf("%-17s %9lld %5.1f%% %5.1f%% %6.2f %5.1f%% %5.1f%% %+9.2f  %s\n", name.substr(0, 17).c_str(), p.hands,
+               100.0 * ratio(p.vpipActions, p.hands), 100.0 * ratio(p.pfrActions, p.hands),
+               p.calls > 0 ? (double)p.raises / p.calls : (double)p.raises,
+               100.0 * ratio(p.showdowns, p.sawFlop), 100.0 * ratio(p.showdownWins, p.showdowns),
+               ratio(p.net, p.hands), read.c_str());
+    }
+
+    static const char* endNames[END_COUNT] = {"Pre-flop", "Flop", "Turn", "River", "Showdown"};
+    printf("\nAI results by street the hand ended:\n");
+    printf("  %-20s %9s %7s %9s\n", "Street", "Hands", "Won", "Chips/hd");
+    for (int i = 0; i < END_COUNT; ++i) {
+        const SituationTotals& s = total.aiByEnd[i];
+        printf("  %-20s %9lld %6.1f%% %+9.2f\n", endNames[i], s.hands, 100.0 * ratio(s.wins, s.hands), ratio(s.net, s.hands));
+    }
+
+    static const char* flopNames[FLOP_COUNT] = {"Made hand (pair+)", "Flush draw", "Open-ended draw", "Gutshot", "Nothing"};
+    printf("\nAI results by holding on the flop:\n");
+    printf("  %-20s %9s %7s %9s\n", "Holding", "Hands", "Won", "Chips/hd");
+    for (int i = 0; i < FLOP_COUNT; ++i) {
+        const SituationTotals& s = total.aiByFlop[i];
+        printf("  %-20s %9lld %6.1f%% %+9.2f\n", flopNames[i], s.hands, 100.0 * ratio(s.wins, s.hands), ratio(s.net, s.hands));
+    }
+    return 0;
+}
+
+static bool parseAnalyzeOptions(int argc, char* argv[], AnalyzeOptions& opt) {
+    if (argc < 3) return false;
+    opt.path = argv[2];
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string a = argv[i];
+        long long v = std::strtoll(argv[i + 1], nullptr, 10);
+        if (a == "--last") opt.lastHands = v;
+        else if (a == "--threads") opt.threads = (int)v;
+        else if (a == "--top") opt.top = (int)v;
+        else return false;
+    }
+    return (argc - 3) % 2 == 0;
+}
+
+// ===== Server Configuration =====
+// Settings for the networked server, from command-line flags and/or a config
+// file of "key = value" lines using the same names as the flags. Without
+// --headless the server keeps its interactive prompts for anything not set.
+struct ServerConfig {
+    int port = PORT;
+    int seats = MAX_PLAYERS;
+    int aiCount = -1;     // -1 = ask "AI player? (y/n)"
+    int ante = ANTE_AMOUNT;
+    int startingChips = STARTING_CHIPS;
+    int trials = MONTE_CARLO_SIMULATIONS;
+    int autoStart = 0;    // Deal once this many are seated; 0 = wait for 'start'
+    int turnTime = TURN_TIME_MS / 1000; // Seconds per action; 0 = no clock
+    int timeBank = TIME_BANK_MS / 1000; // Seconds of time bank per player
+    bool autoContinue = false; // Deal the next hand without asking
+    bool headless = false;     // No stdin, no AI animation; implies the two above
+    std::string historyPath;
+    std::string modelsPath;
+    std::string blueprintPath;
+    std::vector<AIProfile> aiProfiles{AIProfile()};
+    EquitySampling sampling = EquitySampling::Random;
+    GameVariant variant = GameVariant::Holdem;
+    uint64_t seed = 0; // 0 = a fresh random seed each run
+    std::string tracePath; // Non-empty: record spans, dump on SIGUSR1 and at exit
+};
+
+std::atomic<bool> g_shutdown{false};
+std::atomic<bool> g_traceRequested{false}; // SIGUSR1: dump the trace after this hand
+
+static void onShutdownSignal(int) {
+    g_shutdown = true;
+}
+
+static void onTraceSignal(int) {
+    g_traceRequested = true;
+}
+
+static bool parseBool(const std::string& v) {
+    return v.empty() || v == "1" || v == "true" || v == "yes" || v == "on";
+}
+
+static bool setConfigValue(ServerConfig& cfg, const std::string& key, const std::string& value) {
+    auto num = [&](int& out) {
+        char* end = nullptr;
+        long v = std::strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0') return false;
+        out = (int)v;
         return true;
+    };
+    if (key == "port") return num(cfg.port);
+    if (key == "seats") return num(cfg.seats);
+    if (key == "ai") return num(cfg.aiCount);
+    if (key == "ante") return num(cfg.ante);
+    if (key == "chips") return num(cfg.startingChips);
+    if (key == "trials") return num(cfg.trials);
+    if (key == "auto-start") return num(cfg.autoStart);
+    if (key == "turn-time") return num(cfg.turnTime);
+    if (key == "time-bank") return num(cfg.timeBank);
+    if (key == "auto-continue") { cfg.autoContinue = parseBool(value); return true; }
+    if (key == "headless") { cfg.headless = parseBool(value); return true; }
+    if (key == "history") { cfg.historyPath = value; return true; }
+    if (key == "models") { cfg.modelsPath = value; return true; }
+    if (key == "blueprint") { cfg.blueprintPath = value; return true; }
+    if (key == "trace") { cfg.tracePath = value; return true; }
+    if (key == "ai-profile") return parseAIProfiles(value, cfg.aiProfiles);
+    if (key == "sampling") return parseSampling(value, cfg.sampling);
+    if (key == "variant") return parseVariant(value, cfg.variant);
+    if (key == "seed") {
+        char* end = nullptr;
+        cfg.seed = std::strtoull(value.c_str(), &end, 10);
+        return !value.empty() && *end == '\0';
     }
     return false;
 }
-// ===== Main =====
-int main() {
+
+static bool loadConfigFile(ServerConfig& cfg, const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) {
+        std::cerr << "Cannot open config " << path << std::endl;
+        return false;
+    }
+    char line[512];
+    int lineNo = 0;
+    bool ok = true;
+    auto trim = [](std::string s) {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    };
+    while (std::fgets(line, sizeof(line), f)) {
+        lineNo++;
+        std::string s = trim(line);
+        if (s.empty() || s[0] == '#') continue;
+        size_t eq = s.find('=');
+        std::string key = trim(s.substr(0, eq));
+        std::string value = eq == std::string::npos ? "" : trim(s.substr(eq + 1));
+        if (!setConfigValue(cfg, key, value)) {
+            std::cerr << path << ":" << lineNo << ": bad setting '" << s << "'" << std::endl;
+            ok = false;
+        }
+    }
+    std::fclose(f);
+    return ok;
+}
+
+// Flags are applied in order, so ones after --config override the file.
+static bool parseServerConfig(int argc, char* argv[], ServerConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--", 0) != 0) {
+            std::cerr << "Unexpected argument " << a << std::endl;
+            return false;
+        }
+        std::string key = a.substr(2);
+        if (key == "headless" || key == "auto-continue") {
+            setConfigValue(cfg, key, "true");
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << a << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (key == "config") {
+            if (!loadConfigFile(cfg, value)) return false;
+        } else if (!setConfigValue(cfg, key, value)) {
+            std::cerr << "Bad option " << a << " " << value << std::endl;
+            return false;
+        }
+    }
+    if (cfg.headless) {
+        if (cfg.autoStart <= 0) cfg.autoStart = 2;
+        cfg.autoContinue = true;
+        if (cfg.aiCount < 0) cfg.aiCount = 0;
+    }
+    if (cfg.seats < 2 || cfg.seats > MAX_SEATS || cfg.aiCount > cfg.seats || cfg.ante < 0 ||
+        cfg.startingChips <= 0 || cfg.trials < 1 || cfg.autoStart < 0 || cfg.autoStart > cfg.seats ||
+        cfg.turnTime < 0 || cfg.timeBank < 0) {
+        std::cerr << "Invalid configuration: need 2-" << MAX_SEATS << " seats, ai <= seats, ante >= 0, "
+                  << "chips > 0, trials >= 1, auto-start <= seats and non-negative times." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printServerUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--config FILE] [--port N] [--seats N] [--ai N] [--ante N]"
+              << " [--chips N] [--trials N] [--sampling MODE] [--variant GAME] [--seed N] [--auto-start N] [--auto-continue] [--headless]"
+              << " [--turn-time SEC] [--time-bank SEC]"
+              << " [--ai-profile P[,P...]] [--history FILE] [--models FILE] [--blueprint FILE] [--trace FILE]" << std::endl;
+}
+
+// ===== Networked Server =====
+int runServer(const ServerConfig& cfg) {
     // Prevent SIGPIPE on POSIX; initialize Winsock on Windows
 #ifndef _WIN32
     signal(SIGPIPE, SIG_IGN);
@@ -897,25 +5864,70 @@ int main() {
         return 1;
     }
 #endif
-    {
+    signal(SIGINT, onShutdownSignal);
+    signal(SIGTERM, onShutdownSignal);
+#ifndef _WIN32
+    signal(SIGUSR1, onTraceSignal);
+#endif
+    traceThreadName("table");
+    g_traceEnabled = !cfg.tracePath.empty();
+
+    Table table;
+    SeatMap& players = table.players;
+    table.maxSeats = cfg.seats;
+    table.ante = cfg.ante;
+    table.startingChips = cfg.startingChips;
+    table.simulations = cfg.trials;
+    table.sampling = cfg.sampling;
+    table.variant = cfg.variant;
+    // Logged at startup so a session's deals and AI rolls can be repeated.
+    uint64_t seed = cfg.seed ? cfg.seed : randomSeed();
+    table.seed = deriveKey(seed, 0);
+    table.thinkDelay = !cfg.headless;
+    table.turnTimeMs = cfg.turnTime * 1000;
+    table.timeBankMs = cfg.timeBank * 1000;
+
+    HandHistoryWriter history;
+    OpponentStore models;
+    if (!cfg.historyPath.empty()) {
+        if (!history.open(cfg.historyPath)) {
+            std::cerr << "Cannot open hand history " << cfg.historyPath << std::endl;
+            return 1;
+        }
+        table.history = &history;
+    }
+    if (!cfg.modelsPath.empty()) {
+        if (!models.open(cfg.modelsPath)) {
+            std::cerr << "Cannot open opponent model store " << cfg.modelsPath << std::endl;
+            return 1;
+        }
+        table.models = &models;
+    }
+    if (!cfg.blueprintPath.empty() && !loadBlueprint(cfg.blueprintPath, cfg.ante, cfg.startingChips)) return 1;
+
+    int aiCount = cfg.aiCount;
+    if (aiCount < 0) {
         std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cout << "AI player? (y/n):";
+        std::cout << "AI player? (y/n or a count):";
         char c;
         std::cin >> c;
         std::cin.ignore(); 
-        if (c == 'y' || c == 'Y') {
-            Player ai;
-            ai.name = "AI_Bot";
-            ai.isAI = true;
-            players.push_back(ai);
-            std::cout << "AI joined.\n";
-        }
+        if (c >= '0' && c <= '9') aiCount = std::min(c - '0', cfg.seats);
+        else aiCount = (c == 'y' || c == 'Y') ? 1 : 0;
+    }
+    for (int i = 0; i < aiCount; ++i) {
+        Player ai;
+        ai.name = i == 0 ? "AI_Bot" : "AI_Bot" + std::to_string(i + 1);
+        ai.isAI = true;
+        ai.profile = cfg.aiProfiles[i % cfg.aiProfiles.size()];
+        ai.chips = table.startingChips;
+        players.push_back(ai);
+        std::cout << ai.name << " (" << ai.profile.name << ") joined.\n";
     }
     
     socket_t server_fd;
     struct sockaddr_in address;
     int opt = 1;
-    socklen_t addrlen = sizeof(address);
     
     server_fd = socket(AF_INET, SOCK_STREAM, 0);
 #ifdef _WIN32
@@ -925,296 +5937,107 @@ int main() {
 #endif
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(cfg.port);
     bind(server_fd, (struct sockaddr*)&address, sizeof(address));
-    listen(server_fd, MAX_PLAYERS);
+    listen(server_fd, SOMAXCONN); // Clients beyond the seats wait in the lobby
     
     {
         std::lock_guard<std::mutex> lock(g_io_mutex);
-        std::cout << "Server started on port " << PORT << ". Waiting...\n";
+        std::cout << "Server started on port " << cfg.port << ", seed " << seed << ". Waiting...\n";
     }
     
-    // --- Connection Accepting Thread ---
-    std::thread([&]() {
-        while (true) {
-            socket_t sock = accept(server_fd, (struct sockaddr*)&address, &addrlen);
-#ifdef _WIN32
-            if (sock == INVALID_SOCKET) continue;
-#else
-            if (sock < 0) continue;
-#endif
-            // Enable keepalive and disable SIGPIPE on this socket (macOS)
-            int one = 1;
-        #ifdef _WIN32
-            setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (const char*)&one, sizeof(one));
-        #else
-            setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
-        #endif
-#ifdef SO_NOSIGPIPE
-            setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
-#endif
-            // Read the player name as a line terminated by '\n'
-            std::string nb;
-            char b[1024];
-            while (true) {
-                int vr = READSOCK(sock, b, sizeof(b));
-#ifdef _WIN32
-                if (vr <= 0) { CLOSESOCK(sock); sock = INVALID_SOCKET_VAL; break; }
-#else
-                if (vr <= 0) { CLOSESOCK(sock); sock = INVALID_SOCKET_VAL; break; }
-#endif
-                nb.append(b, b + vr);
-                size_t nl = nb.find('\n');
-                if (nl != std::string::npos) {
-                    // Extract name up to newline
-                    std::string pn = nb.substr(0, nl);
-                    pn.erase(std::remove(pn.begin(), pn.end(), '\r'), pn.end());
-
-                    // Any extra complete lines after name: push to inbound queue
-                    std::string rest = nb.substr(nl + 1);
-                    size_t pos = 0;
-                    while ((pos = rest.find('\n')) != std::string::npos) {
-                        std::string msg = rest.substr(0, pos);
-                        msg.erase(std::remove(msg.begin(), msg.end(), '\r'), msg.end());
-                        {
-                            std::lock_guard<std::mutex> lock(g_inbound_mutex);
-                            g_inbound_messages.push({sock, msg});
-                        }
-                        rest.erase(0, pos + 1);
-                    }
-
-                    // Register player
-                    {
-                        std::lock_guard<std::mutex> lock(g_players_mutex);
-                        if (players.size() >= MAX_PLAYERS) {
-                            std::string full = "SERVER_FULL\n";
-                            sendAll(sock, full.c_str(), full.size());
-                            CLOSESOCK(sock);
-                            sock = INVALID_SOCKET_VAL;
-                            break;
-                        }
-                        Player p;
-                        p.name = pn;
-                        p.socket = sock;
-                        players.push_back(p);
-                        std::string w = "WELCOME " + pn + "\n";
-                        sendAll(sock, w.c_str(), w.size());
-                        {
-                            std::lock_guard<std::mutex> io(g_io_mutex);
-                            std::cout << pn << " connected.\n";
-                        }
-                    }
-                    break; // Done with handshake
-                }
-                // continue reading until newline
-            }
-        #ifdef _WIN32
-            if (sock == INVALID_SOCKET_VAL) continue;
-        #else
-            if (sock == INVALID_SOCKET_VAL) continue;
-        #endif
-            {
-                // Start client handler after successful registration
-                std::thread(clientHandler, sock).detach();
-            }
-        }
-    }).detach();
+    // --- Connection reactor: handshakes, lobby and client input ---
+    ConnectionReactor reactor(table, server_fd);
+    table.reactor = &reactor;
+    std::thread reactorThread([&reactor]() {
+        traceThreadName("reactor");
+        reactor.run();
+    });
     
-    // --- Admin 'start' loop ---
-    std::string command;
-    while (true) {
+    // --- Start: admin command, or automatically once enough are seated ---
+    auto seated = [&]() {
+        std::lock_guard<std::mutex> lock(table.playersMutex);
+        return (int)players.size();
+    };
+    // A SIGUSR1 dump is written between hands or while the table waits.
+    auto serviceTrace = [&]() {
+        if (!cfg.tracePath.empty() && g_traceRequested.exchange(false)) dumpTrace(cfg.tracePath);
+    };
+    auto waitForPlayers = [&](int needed) {
+        while (!g_shutdown && seated() < needed) {
+            serviceTrace();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return !g_shutdown;
+    };
+    if (cfg.autoStart > 0) {
         {
-            std::lock_guard<std::mutex> lock(g_players_mutex);
-            std::cout << "\nPlayers(" << players.size() << "/" << MAX_PLAYERS << "):";
-            for (auto &p : players) std::cout << p.name << " ";
-            std::cout << std::endl;
+            std::lock_guard<std::mutex> lock(g_io_mutex);
+            std::cout << "Dealing automatically once " << cfg.autoStart << " players are seated.\n";
         }
-        std::cout << "Type 'start':";
-        std::getline(std::cin, command);
-        if (command == "start") {
-            if (players.size() >= 2) break;
-            std::cout << "Need >= 2 players.\n";
+        waitForPlayers(std::max(2, cfg.autoStart));
+    } else {
+        std::string command;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(table.playersMutex);
+                std::cout << "\nPlayers(" << players.size() << "/" << table.maxSeats << "):";
+                for (auto &p : players) std::cout << p.name << " ";
+                std::cout << std::endl;
+            }
+            std::cout << "Type 'start':";
+            std::getline(std::cin, command);
+            if (command == "start") {
+                if (players.size() >= 2) break;
+                std::cout << "Need >= 2 players.\n";
+            }
         }
     }
 
     // ===== Main Game Loop =====
-    while (true) {
-        resetForNextHand();
+    const std::string handOver = signalFrame(WF_HAND_OVER);
+    while (!g_shutdown) {
+        resetForNextHand(table);
         
         if (players.size() < 2) {
             std::cout << "Not enough players.\n";
-            broadcast("Not enough players.");
+            broadcast(table, "Not enough players.");
+            if (cfg.autoContinue && waitForPlayers(std::max(2, cfg.autoStart))) continue;
             break;
         }
         
-        // --- Ante ---
-        {
-            std::lock_guard<std::mutex> lock(g_players_mutex);
-            {
-                std::stringstream ss;
-                ss << "Collecting ante of " << ANTE_AMOUNT;
-                {
-                    std::lock_guard<std::mutex> io(g_io_mutex);
-                    std::cout << ss.str() << std::endl;
-                }
-                broadcast_unsafe(ss.str());
-            }
-            for (auto& p : players) {
-                if (p.isConnected) {
-                    int a = std::min(ANTE_AMOUNT, p.chips);
-                    p.chips -= a;
-                    pot += a;
-                    if (p.chips == 0 && a > 0) {
-                        p.allIn = true;
-                        broadcast_unsafe(p.name + " is all-in from ante.");
-                    }
-                }
-            }
-            {
-                std::stringstream ss;
-                ss << "Pot starts at " << pot;
-                {
-                    std::lock_guard<std::mutex> io(g_io_mutex);
-                    std::cout << ss.str() << std::endl;
-                }
-                broadcast_unsafe(ss.str());
-            }
-        }
-        
-        {
-            std::lock_guard<std::mutex> lock(g_players_mutex);
-            for (auto& p : players) p.handsPlayed++;
-        }
-        
-        broadcast("GAME_STARTING");
-        
-        // --- Deal Hole Cards ---
-        for (auto &p : players) {
-            if (p.hand.empty()) {
-                p.hand.push_back(drawCard());
-                p.hand.push_back(drawCard());
-                if (!p.isAI) {
-                    sendToPlayer(p, "HOLE " + p.hand[0].toString() + " " + p.hand[1].toString());
-                } else {
-                    std::lock_guard<std::mutex> lock(g_io_mutex);
-                    std::cout << "AI hole cards:\n" << displayCards(p.hand);
-                }
-            }
-        }
-        
-        // --- Betting Rounds ---
-        bettingRound(0); // Pre-flop
-        if (checkIfHandOver()) continue;
-        
-        for (int i = 0; i < 3; i++) communityCards.push_back(drawCard()); // Flop
-        showTable();
-        bettingRound(1); // Post-flop
-        if (checkIfHandOver()) continue;
-        
-        communityCards.push_back(drawCard()); // Turn
-        showTable();
-        bettingRound(2); // Post-turn
-        if (checkIfHandOver()) continue;
-        
-        communityCards.push_back(drawCard()); // River
-        showTable();
-        bettingRound(3); // Post-river
-        if (checkIfHandOver()) continue;
-
-        broadcast("\n--- SHOWDOWN ---");
-        {
-            std::lock_guard<std::mutex> lock(g_io_mutex);
-            std::cout << "\n--- SHOWDOWN ---" << std::endl;
-        }
-        
-        // ===== UPDATED: SHOWDOWN LOGIC FOR SPLIT POTS =====
-        std::vector<Player*> winners;
-        HandResult bestHand = {0, "Nothing"};
-
-{
-            std::lock_guard<std::mutex> lock(g_players_mutex);
-            for (auto& p : players) {
-                // --- NEW DISPLAY LOGIC ---
-                if (p.isConnected && !p.hand.empty()) {
-                    std::string bcHand = p.name + "'s hand: " + p.hand[0].toString() + " " + p.hand[1].toString();
-                    broadcast_unsafe(bcHand);
-                    
-                    std::string coutHand = p.name + "'s hand: " + p.hand[0].rank + p.hand[0].suit + " " + p.hand[1].rank + p.hand[1].suit;
-                    {
-                        std::lock_guard<std::mutex> io(g_io_mutex);
-                        std::cout << coutHand << std::endl;
-                    }
-                }
-
-                // --- WINNER EVALUATION LOGIC ---
-                // Now, separately, check if the player is eligible to win (NOT folded).
-                if (!p.folded && p.isConnected) {
-                    HandResult hand = getFullPlayerHand(p, communityCards);
-                    
-                    if (hand.rank > bestHand.rank) {
-                        bestHand = hand;
-                        winners.clear(); // New best hand, clear old winners
-                        winners.push_back(&p);
-                    } else if (hand.rank == bestHand.rank && bestHand.rank > 0) {
-                        winners.push_back(&p); // Tied for best hand
-                    }
-                }
-            }
-        }
+        playHand(table);
+        serviceTrace();
 
-        if (!winners.empty()) {
-            std::string msg;
-            if (winners.size() == 1) {
-                // Single winner
-                Player* winner = winners[0];
-                msg = winner->name + " wins " + std::to_string(pot) + " with " + bestHand.name + "!";
-                winner->chips += pot;
-            } else {
-                // Split pot
-                int splitAmount = pot / winners.size();
-                int remainder = pot % winners.size();
-                std::string winnerNames;
-                for (size_t i = 0; i < winners.size(); ++i) {
-                    winnerNames += winners[i]->name;
-                    if (i < winners.size() - 1) winnerNames += ", ";
-                    winners[i]->chips += splitAmount;
-                }
-                winners[0]->chips += remainder; 
-                msg = "Split pot! " + std::to_string(pot) + " split between: " + winnerNames + " with " + bestHand.name;
-            }
-            broadcast(msg);
-            {
-                std::lock_guard<std::mutex> lock(g_io_mutex);
-                std::cout << msg << std::endl;
-            }
-        } else {
-            std::string msg = "No winner, pot returned (NI).";
-            broadcast(msg);
-            {
-                std::lock_guard<std::mutex> lock(g_io_mutex);
-                std::cout << msg << std::endl;
-            }
+        if (cfg.autoContinue) {
+            broadcast(table, "HAND_OVER", &handOver);
+            continue;
         }
-        // ===== END UPDATED SHOWDOWN LOGIC =====
 
         std::string choice;
         {
             std::lock_guard<std::mutex> lock(g_io_mutex);
             std::cout << "--- Hand Over ---\nAnother round? (y/n):";
         }
-        broadcast("HAND_OVER\nWaiting for admin...");
+        broadcast(table, "HAND_OVER", &handOver);
+        broadcast(table, "Waiting for admin...");
         std::cin.clear();
         std::getline(std::cin, choice);
         
         if (choice.empty() || (choice[0] != 'y' && choice[0] != 'Y')) {
-            broadcast("Game ending.");
-            {
-                std::lock_guard<std::mutex> lock(g_io_mutex);
-                std::cout << "Shutting down.\n";
-            }
             break;
         }
     }
+
+    broadcast(table, "Game ending.");
+    {
+        std::lock_guard<std::mutex> lock(g_io_mutex);
+        std::cout << "Shutting down.\n";
+    }
+    if (!cfg.tracePath.empty()) dumpTrace(cfg.tracePath);
+    reactor.stop();
+    reactorThread.join();
+    table.reactor = nullptr;
     
     std::cout << "Game Over.\n";
 #ifdef _WIN32
@@ -1222,3 +6045,60 @@ int main() {
 #endif
     return 0;
 }
+
+// ===== Main =====
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--simulate") == 0) {
+        SimOptions opt;
+        std::string historyPath;
+        if (!parseSimOptions(argc, argv, opt, historyPath)) {
+            std::cerr << "Usage: " << argv[0] << " --simulate [--tables N] [--hands N] [--seats N]"
+                      << " [--threads N] [--trials N] [--sampling MODE] [--variant GAME] [--seed N] [--profiles P[,P...]] [--history FILE]"
+                      << " [--blueprint FILE] [--trace FILE]" << std::endl;
+            return 1;
+        }
+        HandHistoryWriter history;
+        if (!historyPath.empty()) {
+            if (!history.open(historyPath)) {
+                std::cerr << "Cannot open hand history " << historyPath << std::endl;
+                return 1;
+            }
+            opt.history = &history;
+        }
+        return runSimulation(opt);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--check-equity") == 0) {
+        CheckOptions opt;
+        if (!parseCheckOptions(argc, argv, opt)) {
+            std::cerr << "Usage: " << argv[0] << " --check-equity [--trials N] [--runs N] [--threads N] [--seed N]" << std::endl;
+            return 1;
+        }
+        return checkEquity(opt);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--solve") == 0) {
+        SolveOptions opt;
+        if (!parseSolveOptions(argc, argv, opt)) {
+            std::cerr << "Usage: " << argv[0] << " --solve FILE [--iterations N] [--threads N] [--seed N] [--ante N] [--chips N]" << std::endl;
+            return 1;
+        }
+        return solveBlueprint(argv[2], opt);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--replay") == 0) {
+        return replayHandHistory(argv[2]);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--analyze") == 0) {
+        AnalyzeOptions opt;
+        if (!parseAnalyzeOptions(argc, argv, opt)) {
+            std::cerr << "Usage: " << argv[0] << " --analyze FILE [--last N] [--threads N] [--top N]" << std::endl;
+            return 1;
+        }
+        return analyzeHandHistory(opt);
+    }
+
+    ServerConfig cfg;
+    if (!parseServerConfig(argc, argv, cfg)) {
+        printServerUsage(argv[0]);
+        return 1;
+    }
+    return runServer(cfg);
+}